@@ -0,0 +1,154 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "frame_stats.h"
+#ifndef _LIBDMR_
+#include "dmr_settings.h"
+#endif
+
+namespace dmr {
+
+static std::atomic<FrameStats *> _instance { nullptr };
+static QMutex _instLock;
+
+// upper edges in msecs, the last bucket takes everything beyond
+static const QVector<int> bucketEdges = {4, 8, 12, 17, 20, 25, 34, 50, 100};
+
+FrameStats &FrameStats::get()
+{
+    if (_instance == nullptr) {
+        QMutexLocker lock(&_instLock);
+        if (_instance == nullptr) {
+            _instance = new FrameStats;
+        }
+    }
+
+    return *_instance;
+}
+
+FrameStats::FrameStats()
+{
+    _samples.reserve(MAX_SAMPLES);
+#ifndef _LIBDMR_
+    _overlay = Settings::get().internalOption("frame_stats_overlay").toBool();
+#endif
+}
+
+void FrameStats::addFrame(const Sample &s)
+{
+    if (_samples.size() < MAX_SAMPLES) {
+        _samples.append(s);
+    } else {
+        _samples[_next] = s;
+    }
+    _next = (_next + 1) % MAX_SAMPLES;
+}
+
+void FrameStats::setVoCounters(qint64 dropped, qint64 delayed, double vfFps)
+{
+    _dropped = dropped;
+    _delayed = delayed;
+    _vfFps = vfFps;
+}
+
+void FrameStats::reset()
+{
+    _samples.clear();
+    _next = 0;
+    _dropped = _delayed = 0;
+    _vfFps = 0.0;
+}
+
+void FrameStats::setOverlayVisible(bool on)
+{
+    if (_overlay != on) {
+        _overlay = on;
+        emit overlayVisibleChanged(on);
+    }
+}
+
+QStringList FrameStats::summary() const
+{
+    qint64 upd = 0, paint = 0, swap = 0, ival = 0;
+    qint64 paintMax = 0, ivalMax = 0;
+    for (const auto &s : _samples) {
+        upd += s.updateUs;
+        paint += s.paintUs;
+        swap += s.swapUs;
+        ival += s.intervalUs;
+        paintMax = qMax(paintMax, s.paintUs);
+        ivalMax = qMax(ivalMax, s.intervalUs);
+    }
+
+    int n = qMax(1, _samples.size());
+    auto ms = [](qint64 us) { return QString::number(us / 1000.0, 'f', 2); };
+
+    return {
+        QString("frames %1, vf %2 fps").arg(_samples.size()).arg(_vfFps, 0, 'f', 2),
+        QString("update %1 ms").arg(ms(upd / n)),
+        QString("paint %1 ms (max %2)").arg(ms(paint / n)).arg(ms(paintMax)),
+        QString("swap %1 ms").arg(ms(swap / n)),
+        QString("interval %1 ms (max %2)").arg(ms(ival / n)).arg(ms(ivalMax)),
+        QString("dropped %1, delayed %2").arg(_dropped).arg(_delayed),
+    };
+}
+
+QVariantMap FrameStats::snapshot() const
+{
+    QVector<int> paint(bucketEdges.size() + 1, 0);
+    QVector<int> interval(bucketEdges.size() + 1, 0);
+
+    auto bucketOf = [](qint64 us) {
+        auto p = std::lower_bound(bucketEdges.cbegin(), bucketEdges.cend(), int(us / 1000));
+        return int(p - bucketEdges.cbegin());
+    };
+
+    for (const auto &s : _samples) {
+        paint[bucketOf(s.paintUs)]++;
+        interval[bucketOf(s.intervalUs)]++;
+    }
+
+    auto toList = [](const QVector<int> &v) {
+        QVariantList l;
+        for (auto i : v) l << i;
+        return l;
+    };
+
+    QVariantMap m;
+    m["frames"] = _samples.size();
+    m["bucket_edges_ms"] = toList(bucketEdges);
+    m["paint_histogram"] = toList(paint);
+    m["interval_histogram"] = toList(interval);
+    m["frame_drop_count"] = _dropped;
+    m["vo_delayed_frame_count"] = _delayed;
+    m["estimated_vf_fps"] = _vfFps;
+    return m;
+}
+
+}
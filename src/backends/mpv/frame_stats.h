@@ -0,0 +1,91 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_FRAME_STATS_H
+#define _DMR_FRAME_STATS_H
+
+#include <QtGui>
+#include <atomic>
+
+namespace dmr {
+
+/*
+   class FrameStats
+   per-frame timing of the gl renderer, kept for the last few seconds:
+   how long mpv_render_context_update took, how long paintGL ran, and how
+   long it took until the frame got swapped, plus the vo counters mpv keeps
+   (dropped/delayed frames, estimated filter fps). shown as an overlay on
+   top of the video and queried as histograms over D-Bus.
+   gui thread only.
+*/
+class FrameStats: public QObject
+{
+    Q_OBJECT
+public:
+    struct Sample {
+        qint64 updateUs {0};   // mpv_render_context_update
+        qint64 paintUs {0};    // paintGL
+        qint64 swapUs {0};     // end of paintGL to frameSwapped
+        qint64 intervalUs {0}; // since the previous swap
+    };
+
+    static FrameStats &get();
+
+    void addFrame(const Sample &s);
+    void setVoCounters(qint64 dropped, qint64 delayed, double vfFps);
+    void reset();
+
+    bool overlayVisible() const { return _overlay; }
+    void setOverlayVisible(bool on);
+
+    // one line per metric, for the overlay
+    QStringList summary() const;
+    // histograms of paint time and frame interval over the kept frames,
+    // upper bucket edges in msecs and the vo counters
+    QVariantMap snapshot() const;
+
+signals:
+    void overlayVisibleChanged(bool on);
+
+private:
+    static const int MAX_SAMPLES = 600;
+
+    QVector<Sample> _samples;
+    int _next {0};
+    qint64 _dropped {0};
+    qint64 _delayed {0};
+    double _vfFps {0.0};
+    bool _overlay {false};
+
+    FrameStats();
+};
+
+}
+
+#endif /* ifndef _DMR_FRAME_STATS_H */
@@ -39,57 +39,32 @@
 DWIDGET_USE_NAMESPACE
 
 
-static const char *vs_blend = R"(
+// arc is the offset from the center of the corner's arc, in device pixels
+static const char *vs_clip = R"(
 attribute vec2 position;
-attribute vec2 vTexCoord;
-
-varying vec2 texCoord;
-
-void main() {
-    gl_Position = vec4(position, 0.0, 1.0);
-    texCoord = vTexCoord;
-}
-)";
-
-static const char* fs_blend = R"(
-varying vec2 texCoord;
-
-uniform sampler2D movie;
-
-void main() {
-     gl_FragColor = texture2D(movie, texCoord); 
-}
-)";
+attribute vec2 arcCoord;
 
-static const char* vs_blend_corner = R"(
-attribute vec2 position;
-attribute vec2 maskTexCoord;
-attribute vec2 vTexCoord;
-
-varying vec2 maskCoord;
-varying vec2 texCoord;
+varying vec2 arc;
 
 void main() {
     gl_Position = vec4(position, 0.0, 1.0);
-    texCoord = vTexCoord;
-    maskCoord = maskTexCoord;
+    arc = arcCoord;
 }
 )";
 
-static const char* fs_blend_corner = R"(
-varying vec2 maskCoord;
-varying vec2 texCoord;
+// coverage of the rounded rect, with one pixel of antialiasing. blended as
+// dst * src.a, so video outside the arc turns transparent
+static const char *fs_clip = R"(
+varying vec2 arc;
 
-uniform sampler2D movie;
-uniform sampler2D mask;
+uniform float radius;
 
 void main() {
-     gl_FragColor = texture2D(movie, texCoord) * texture2D(mask, maskCoord).a; 
+    float coverage = clamp(radius - length(arc) + 0.5, 0.0, 1.0);
+    gl_FragColor = vec4(0.0, 0.0, 0.0, coverage);
 }
 )";
 
-
-
 static const char* vs_code = R"(
 attribute vec2 position;
 attribute vec2 vTexCoord;
@@ -162,7 +137,12 @@ namespace dmr {
             context()->swapBuffers(context()->surface());
             doneCurrent();
         } else {
-            mpv_render_context_update(_render_ctx);
+            auto t = _frameClock.nsecsElapsed();
+            auto flags = mpv_render_context_update(_render_ctx);
+            if (flags & MPV_RENDER_UPDATE_FRAME) {
+                _newFrame = true;
+                _frameSample.updateUs = (_frameClock.nsecsElapsed() - t) / 1000;
+            }
             update();
         }
     }
@@ -171,6 +151,28 @@ namespace dmr {
     {
         //qDebug() << "frame swapped";
         mpv_render_context_report_swap(_render_ctx);
+
+        // repaints without a new video frame (overlay, resize, paused
+        // redraws) are not frames and would skew the interval histogram
+        if (!_frameRendered)
+            return;
+        _frameRendered = false;
+
+        auto now = _frameClock.nsecsElapsed();
+        if (_playing && _lastSwapNs > 0) {
+            _frameSample.swapUs = (now - _paintEndNs) / 1000;
+            _frameSample.intervalUs = (now - _lastSwapNs) / 1000;
+            FrameStats::get().addFrame(_frameSample);
+        }
+        _lastSwapNs = _playing ? now : 0;
+        _frameSample = FrameStats::Sample();
+    }
+
+    void MpvGLWidget::resetFrameTiming()
+    {
+        _lastSwapNs = 0;
+        _newFrame = false;
+        _frameSample = FrameStats::Sample();
     }
 
     MpvGLWidget::MpvGLWidget(QWidget *parent, mpv::qt::Handle h)
@@ -180,6 +182,10 @@ namespace dmr {
         connect(this, &QOpenGLWidget::frameSwapped, 
                 this, &MpvGLWidget::onFrameSwapped, Qt::DirectConnection);
 
+        _frameClock.start();
+        connect(&FrameStats::get(), &FrameStats::overlayVisibleChanged,
+                this, [=]() { update(); });
+
         //auto fmt = QSurfaceFormat::defaultFormat();
         //fmt.setAlphaBufferSize(8);
         //this->setFormat(fmt);
@@ -211,12 +217,12 @@ namespace dmr {
             _vboCorners[i].destroy();
         }
 
+        _vboClip.destroy();
+
         _vao.destroy();
-        _vaoBlend.destroy();
+        _vaoClip.destroy();
         _vaoCorner.destroy();
 
-        if (_fbo) delete _fbo;
-
         if (_render_ctx) mpv_render_context_set_update_callback(_render_ctx, NULL, NULL);
         // Until this call is done, we need to make sure the player remains
         // alive. This is done implicitly with the mpv::qt::Handle instance
@@ -225,39 +231,31 @@ namespace dmr {
         doneCurrent();
     }
 
-    void MpvGLWidget::setupBlendPipe()
+    void MpvGLWidget::setupClipPipe()
     {
-        updateMovieFbo();
-
-        _vaoBlend.create();
-        _vaoBlend.bind();
-        updateVboBlend();
-
-        _glProgBlend = new QOpenGLShaderProgram();
-        _glProgBlend->addShaderFromSourceCode(QOpenGLShader::Vertex, vs_blend);
-        _glProgBlend->addShaderFromSourceCode(QOpenGLShader::Fragment, fs_blend);
-        if (!_glProgBlend->link()) {
-            qDebug() << "link failed";
-        }
-        _glProgBlend->bind();
-        _vboBlend.bind();
-
-        int vLocBlend = _glProgBlend->attributeLocation("position");
-        int coordLocBlend = _glProgBlend->attributeLocation("vTexCoord");
-        _glProgBlend->enableAttributeArray(vLocBlend);
-        _glProgBlend->setAttributeBuffer(vLocBlend, GL_FLOAT, 0, 2, 6*sizeof(GLfloat));
-        _glProgBlend->enableAttributeArray(coordLocBlend);
-        _glProgBlend->setAttributeBuffer(coordLocBlend, GL_FLOAT, 2*sizeof(GLfloat), 2, 6*sizeof(GLfloat));
-        _glProgBlend->setUniformValue("movie", 0);
-        _glProgBlend->release();
-        _vaoBlend.release();
-
-        _glProgBlendCorners = new QOpenGLShaderProgram();
-        _glProgBlendCorners->addShaderFromSourceCode(QOpenGLShader::Vertex, vs_blend_corner);
-        _glProgBlendCorners->addShaderFromSourceCode(QOpenGLShader::Fragment, fs_blend_corner);
-        if (!_glProgBlendCorners->link()) {
+        _vaoClip.create();
+        _vaoClip.bind();
+        _vboClip.create();
+        updateVboClip();
+        _vboClip.bind();
+
+        _glProgClip = new QOpenGLShaderProgram();
+        _glProgClip->addShaderFromSourceCode(QOpenGLShader::Vertex, vs_clip);
+        _glProgClip->addShaderFromSourceCode(QOpenGLShader::Fragment, fs_clip);
+        if (!_glProgClip->link()) {
             qDebug() << "link failed";
         }
+        _glProgClip->bind();
+
+        // attributes live in the vao, nothing to set up per frame
+        int vertexLoc = _glProgClip->attributeLocation("position");
+        int arcLoc = _glProgClip->attributeLocation("arcCoord");
+        _glProgClip->enableAttributeArray(vertexLoc);
+        _glProgClip->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 2, 4*sizeof(GLfloat));
+        _glProgClip->enableAttributeArray(arcLoc);
+        _glProgClip->setAttributeBuffer(arcLoc, GL_FLOAT, 2*sizeof(GLfloat), 2, 4*sizeof(GLfloat));
+        _glProgClip->release();
+        _vaoClip.release();
     }
 
     void MpvGLWidget::setupIdlePipe()
@@ -360,7 +358,7 @@ namespace dmr {
 
         prepareSplashImages();
         setupIdlePipe();
-        setupBlendPipe();
+        setupClipPipe();
 
 #ifdef _LIBDMR_
         toggleRoundedClip(false);
@@ -397,22 +395,6 @@ namespace dmr {
                 reinterpret_cast<void*>(this));
     }
 
-    void MpvGLWidget::updateMovieFbo()
-    {
-        if (!_doRoundedClipping) return;
-
-        auto desiredSize = size() * qApp->devicePixelRatio();
-
-        if (_fbo) {
-            if (_fbo->size() == desiredSize) {
-                return;
-            }
-            _fbo->release();
-            delete _fbo;
-        }
-        _fbo = new QOpenGLFramebufferObject(desiredSize);
-    }
-
     void MpvGLWidget::updateCornerMasks()
     {
         if (!_doRoundedClipping) return;
@@ -470,35 +452,51 @@ namespace dmr {
         }
     }
 
-    void MpvGLWidget::updateVboBlend()
+    void MpvGLWidget::updateVboClip()
     {
-        if (!_vboBlend.isCreated()) {
-            _vboBlend.create();
+        // may be called before initializeGL, which builds it anyway
+        if (!_doRoundedClipping || !context()) return;
+
+        makeCurrent();
+        if (!_vboClip.isCreated()) {
+            _vboClip.create();
         }
 
-        GLfloat x1 = -1.0f;
-        GLfloat x2 =  1.0f;
-        GLfloat y1 =  1.0f;
-        GLfloat y2 = -1.0f;
+        auto vp = rect().size();
+        GLfloat rx = 2.0f * RADIUS / vp.width();
+        GLfloat ry = 2.0f * RADIUS / vp.height();
+        GLfloat r = RADIUS * qApp->devicePixelRatio();
+
+        // one quad per corner, (x, y) is the outer corner of the widget and
+        // (dx, dy) points inwards to the center of the arc
+        struct { GLfloat x, y, dx, dy; } corners[4] = {
+            {-1.0f,  1.0f,  rx, -ry},
+            { 1.0f,  1.0f, -rx, -ry},
+            { 1.0f, -1.0f, -rx,  ry},
+            {-1.0f, -1.0f,  rx,  ry},
+        };
 
-        GLfloat s1 = 0.0f;
-        GLfloat t1 = 1.0f;
-        GLfloat s2 = 1.0f;
-        GLfloat t2 = 0.0f;
+        QVector<GLfloat> vdata;
+        vdata.reserve(4 * 6 * 4);
+        for (const auto &c: corners) {
+            GLfloat x1 = c.x, x2 = c.x + c.dx;
+            GLfloat y1 = c.y, y2 = c.y + c.dy;
 
-        GLfloat vdata[] = {
-            x1, y1, s1, t1, 0.0f, 1.0f,
-            x2, y1, s2, t1, 1.0f, 1.0f,
-            x2, y2, s2, t2, 1.0f, 0.0f,
-                                        
-            x1, y1, s1, t1, 0.0f, 1.0f,
-            x2, y2, s2, t2, 1.0f, 0.0f,
-            x1, y2, s1, t2, 0.0f, 0.0f
-        };
+            GLfloat quad[] = {
+                x1, y1, r, r,
+                x2, y1, 0, r,
+                x2, y2, 0, 0,
 
-        _vboBlend.bind();
-        _vboBlend.allocate(vdata, sizeof(vdata));
-        _vboBlend.release();
+                x1, y1, r, r,
+                x2, y2, 0, 0,
+                x1, y2, r, 0,
+            };
+            for (auto v: quad) vdata.append(v);
+        }
+
+        _vboClip.bind();
+        _vboClip.allocate(vdata.constData(), vdata.size() * sizeof(GLfloat));
+        _vboClip.release();
     }
 
     void MpvGLWidget::updateVboCorners()
@@ -596,10 +594,11 @@ namespace dmr {
     {
         QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
 
-        updateMovieFbo();
         updateVbo();
-        if (_doRoundedClipping)
+        if (_doRoundedClipping) {
             updateVboCorners();
+            updateVboClip();
+        }
 
         qDebug() << "GL resize" << w << h;
         QOpenGLWidget::resizeGL(w, h);
@@ -608,8 +607,7 @@ namespace dmr {
     void MpvGLWidget::toggleRoundedClip(bool val)
     {
         _doRoundedClipping = val;
-        makeCurrent();
-        updateMovieFbo();
+        updateVboClip();
         update();
     }
 
@@ -617,90 +615,45 @@ namespace dmr {
     {
         QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
         if (_playing) {
+            auto paintStart = _frameClock.nsecsElapsed();
 
             auto dpr = qApp->devicePixelRatio();
             QSize scaled = size() * dpr;
             int flip = 1;
 
-            if (!_doRoundedClipping) {
-                mpv_opengl_fbo fbo {
-                    static_cast<int>(defaultFramebufferObject()), scaled.width(), scaled.height(), 0
-                };
-
-                mpv_render_param params[] = {
-                    {MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
-                    {MPV_RENDER_PARAM_FLIP_Y, &flip},
-                    {MPV_RENDER_PARAM_INVALID, nullptr}
-                };
-
-                mpv_render_context_render(_render_ctx, params);
-            } else {
-                f->glEnable(GL_BLEND);
-                f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-                _fbo->bind();
+            mpv_opengl_fbo fbo {
+                static_cast<int>(defaultFramebufferObject()), scaled.width(), scaled.height(), 0
+            };
 
-                mpv_opengl_fbo fbo {
-                    static_cast<int>(_fbo->handle()), scaled.width(), scaled.height(), 0
-                };
+            mpv_render_param params[] = {
+                {MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
+                {MPV_RENDER_PARAM_FLIP_Y, &flip},
+                {MPV_RENDER_PARAM_INVALID, nullptr}
+            };
 
-                mpv_render_param params[] = {
-                    {MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
-                    {MPV_RENDER_PARAM_FLIP_Y, &flip},
-                    {MPV_RENDER_PARAM_INVALID, nullptr}
-                };
+            mpv_render_context_render(_render_ctx, params);
+            _frameRendered = _newFrame;
+            _newFrame = false;
 
-                mpv_render_context_render(_render_ctx, params);
+            if (_doRoundedClipping) {
+                QOpenGLVertexArrayObject::Binder vaoBind(&_vaoClip);
+                f->glEnable(GL_BLEND);
+                f->glBlendFunc(GL_ZERO, GL_SRC_ALPHA);
 
-                _fbo->release();
+                _glProgClip->bind();
+                _glProgClip->setUniformValue("radius", GLfloat(RADIUS * dpr));
+                f->glDrawArrays(GL_TRIANGLES, 0, 4 * 6);
+                _glProgClip->release();
 
-                {
-                    QOpenGLVertexArrayObject::Binder vaoBind(&_vaoBlend);
-                    _glProgBlend->bind();
-                    f->glActiveTexture(GL_TEXTURE0);
-                    f->glBindTexture(GL_TEXTURE_2D, _fbo->texture());
-                    f->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                    f->glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                    f->glDrawArrays(GL_TRIANGLES, 0, 6);
-                    _glProgBlend->release();
-                }
+                f->glDisable(GL_BLEND);
+            }
 
-                {
-                    f->glBlendFunc(GL_SRC_ALPHA, GL_ZERO);
-                    // blend corners
-                    //QOpenGLVertexArrayObject::Binder vaoBind(&_vaoCorner);
-
-                    for (int i = 0; i < 4; i++) {
-                        _glProgBlendCorners->bind();
-                        _vboCorners[i].bind();
-
-                        int vertexLoc = _glProgBlendCorners->attributeLocation("position");
-                        int maskLoc = _glProgBlendCorners->attributeLocation("maskTexCoord");
-                        int coordLoc = _glProgBlendCorners->attributeLocation("vTexCoord");
-                        _glProgBlendCorners->enableAttributeArray(vertexLoc);
-                        _glProgBlendCorners->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 2, 6*sizeof(GLfloat));
-                        _glProgBlendCorners->enableAttributeArray(maskLoc);
-                        _glProgBlendCorners->setAttributeBuffer(maskLoc, GL_FLOAT, 2*sizeof(GLfloat), 2, 6*sizeof(GLfloat));
-                        _glProgBlendCorners->enableAttributeArray(coordLoc);
-                        _glProgBlendCorners->setAttributeBuffer(coordLoc, GL_FLOAT, 4*sizeof(GLfloat), 2, 6*sizeof(GLfloat));
-                        _glProgBlendCorners->setUniformValue("movie", 0);
-                        _glProgBlendCorners->setUniformValue("mask", 1);
-
-                        f->glActiveTexture(GL_TEXTURE0);
-                        f->glBindTexture(GL_TEXTURE_2D, _fbo->texture());
-
-                        f->glActiveTexture(GL_TEXTURE1);
-                        _cornerMasks[i]->bind();
-
-                        f->glDrawArrays(GL_TRIANGLES, 0, 6);
-
-                        _cornerMasks[i]->release();
-                        _glProgBlendCorners->release();
-                        _vboCorners[i].release();
-                    }
-                }
+            // the overlay's own cost is left out of the paint time
+            _paintEndNs = _frameClock.nsecsElapsed();
+            _frameSample.paintUs = (_paintEndNs - paintStart) / 1000;
 
-                f->glDisable(GL_BLEND);
+            if (FrameStats::get().overlayVisible()) {
+                paintStatsOverlay();
             }
 
         } else {
@@ -774,6 +727,28 @@ namespace dmr {
         }
     }
 
+    void MpvGLWidget::paintStatsOverlay()
+    {
+        auto lines = FrameStats::get().summary();
+
+        QPainter p(this);
+        QFont ft = font();
+        ft.setFamily("monospace");
+        ft.setPixelSize(12);
+        p.setFont(ft);
+
+        QFontMetrics fm(ft);
+        int w = 0;
+        for (const auto &l: lines) {
+            w = qMax(w, fm.width(l));
+        }
+        QRect r(16, 16, w + 16, fm.height() * lines.size() + 12);
+
+        p.fillRect(r, QColor(0, 0, 0, 160));
+        p.setPen(Qt::white);
+        p.drawText(r.adjusted(8, 6, -8, -6), Qt::AlignLeft | Qt::AlignTop, lines.join('\n'));
+    }
+
     void MpvGLWidget::setPlaying(bool val)
     {
         if (_playing != val) {
@@ -781,7 +756,7 @@ namespace dmr {
         }
         updateVbo();
         updateVboCorners();
-        updateMovieFbo();
+        updateVboClip();
         update();
     }
 
@@ -791,6 +766,7 @@ namespace dmr {
             _inMiniMode = val;
             updateVbo();
             updateVboCorners();
+            updateVboClip();
             update();
         }
     }
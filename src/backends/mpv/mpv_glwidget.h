@@ -36,6 +36,7 @@
 #undef Bool
 #include <mpv/qthelper.hpp>
 #include <DGuiApplicationHelper>
+#include "frame_stats.h"
 //DWIDGET_USE_NAMESPACE
 namespace dmr {
 class MpvGLWidget : public QOpenGLWidget
@@ -48,7 +49,8 @@ public:
     virtual ~MpvGLWidget();
 
     /*
-     * rounded clipping consumes a lot of resources, and performs bad on 4K video
+     * video is rendered straight into the widget, rounded corners are cut
+     * afterwards by one small draw over the four corners
      */
     void toggleRoundedClip(bool val);
 
@@ -58,6 +60,8 @@ protected:
     void paintGL() override;
 
     void setPlaying(bool);
+    // a pause breaks the frame interval, the next frame starts afresh
+    void resetFrameTiming();
     void setMiniMode(bool);
 
 protected slots:
@@ -72,6 +76,16 @@ private:
     bool _inMiniMode {false};
     bool _doRoundedClipping {true};
 
+    // frame timing, see FrameStats
+    QElapsedTimer _frameClock;
+    qint64 _paintEndNs {0};
+    qint64 _lastSwapNs {0};
+    // mpv reported a new frame that has not been painted yet
+    bool _newFrame {false};
+    // the pending swap carries a new mpv frame
+    bool _frameRendered {false};
+    FrameStats::Sample _frameSample;
+
     QOpenGLVertexArrayObject _vao;
     QOpenGLBuffer _vbo;
     QOpenGLTexture *_darkTex {nullptr};
@@ -79,11 +93,10 @@ private:
     QOpenGLTexture *_lightTex {nullptr};
     QOpenGLShaderProgram *_glProg {nullptr};
 
-    QOpenGLVertexArrayObject _vaoBlend;
-    QOpenGLBuffer _vboBlend;
-    QOpenGLShaderProgram *_glProgBlend {nullptr};
-    QOpenGLFramebufferObject *_fbo {nullptr};
-    QOpenGLShaderProgram *_glProgBlendCorners {nullptr};
+    // corners clipped out of the rendered video
+    QOpenGLVertexArrayObject _vaoClip;
+    QOpenGLBuffer _vboClip;
+    QOpenGLShaderProgram *_glProgClip {nullptr};
 
     //textures for corner
     QOpenGLVertexArrayObject _vaoCorner;
@@ -97,15 +110,15 @@ private:
 
     void updateVbo();
     void updateVboCorners();
-    void updateVboBlend();
+    void updateVboClip();
 
-    void updateMovieFbo();
     void updateCornerMasks();
 
-    void setupBlendPipe();
+    void setupClipPipe();
     void setupIdlePipe();
 
     void prepareSplashImages();
+    void paintStatsOverlay();
 
 };
 
@@ -31,6 +31,9 @@
 
 #include "mpv_proxy.h"
 #include "mpv_glwidget.h"
+#include "mpv_sw_renderer.h"
+#include "burst_extractor.h"
+#include "frame_stats.h"
 #include "compositing_manager.h"
 #include "utility.h"
 #include "player_engine.h"
@@ -82,6 +85,15 @@ MpvProxy::MpvProxy(QWidget *parent)
     : Backend(parent)
 {
     m_parentWidget = parent;
+    if (_headless != HeadlessMode::NoHeadless) {
+        // no window system involved at all, not even to detect compositing
+        _handle = Handle::FromRawHandle(mpv_init());
+        if (_headless == HeadlessMode::HeadlessSoftware) {
+            _swRenderer = new MpvSwRenderer(_handle);
+        }
+        return;
+    }
+
     if (!CompositingManager::get().composited()) {
         setWindowFlags(Qt::FramelessWindowHint);
         setAttribute(Qt::WA_NativeWindow);
@@ -112,6 +124,12 @@ MpvProxy::~MpvProxy()
 {
     disconnect(this, &MpvProxy::has_mpv_events, this, &MpvProxy::handle_mpv_events);
     _connectStateChange = false;
+    if (_headless != HeadlessMode::NoHeadless) {
+        // the render context has to go before the mpv handle
+        delete _swRenderer;
+        return;
+    }
+
     disconnect(window()->windowHandle(), &QWindow::windowStateChanged, 0, 0);
     if (CompositingManager::get().composited()) {
         disconnect(this, &MpvProxy::stateChanged, 0, 0);
@@ -123,7 +141,8 @@ mpv_handle *MpvProxy::mpv_init()
 {
     mpv_handle *h = mpv_create();
 
-    bool composited = CompositingManager::get().composited();
+    bool headless = _headless != HeadlessMode::NoHeadless;
+    bool composited = !headless && CompositingManager::get().composited();
 
     switch (_debugLevel) {
     case DebugLevel::Info:
@@ -255,7 +274,16 @@ mpv_handle *MpvProxy::mpv_init()
     set_property(h, "panscan", 1.0);
     //set_property(h, "no-keepaspect", "true");
 
-    if (composited) {
+    if (headless) {
+        // decode on the cpu so timings don't depend on the box's gpu
+        set_property(h, "hwdec", "no");
+        set_property(h, "ao", "null");
+        if (_headless == HeadlessMode::HeadlessSoftware) {
+            set_property(h, "vo", "libmpv");
+        } else {
+            set_property(h, "vo", "null");
+        }
+    } else if (composited) {
         //vo=gpu seems broken, it'll makes video output into a seperate window
         //set_property(h, "vo", "gpu");
 #ifdef __mips__
@@ -305,6 +333,9 @@ mpv_handle *MpvProxy::mpv_init()
     set_property(h, "sub-margin-y", 36);
     set_property(h, "sub-border-size", 0);
 
+    // open the queued entry (see queueNext) while the current one plays
+    set_property(h, "prefetch-playlist", "yes");
+
     set_property(h, "screenshot-template", "deepin-movie-shot%n");
     set_property(h, "screenshot-directory", "/tmp");
 
@@ -314,15 +345,23 @@ mpv_handle *MpvProxy::mpv_init()
     }
 #endif
 
+    // values of these are kept in _mirror
+    mpv_observe_property(h, 0, "time-pos", MPV_FORMAT_DOUBLE); //playback-time ?
+    mpv_observe_property(h, 0, "duration", MPV_FORMAT_DOUBLE);
+    mpv_observe_property(h, 0, "pause", MPV_FORMAT_FLAG);
+    mpv_observe_property(h, 0, "volume", MPV_FORMAT_DOUBLE); //ao-volume ?
+    mpv_observe_property(h, 0, "dwidth", MPV_FORMAT_INT64);
+    mpv_observe_property(h, 0, "dheight", MPV_FORMAT_INT64);
+    mpv_observe_property(h, 0, "video-out-params/rotate", MPV_FORMAT_INT64);
+    // vo counters, forwarded to FrameStats as they change
+    mpv_observe_property(h, 0, "frame-drop-count", MPV_FORMAT_INT64);
+    mpv_observe_property(h, 0, "vo-delayed-frame-count", MPV_FORMAT_INT64);
+    mpv_observe_property(h, 0, "estimated-vf-fps", MPV_FORMAT_DOUBLE);
+
     //only to get notification without data
-    mpv_observe_property(h, 0, "time-pos", MPV_FORMAT_NONE); //playback-time ?
-    mpv_observe_property(h, 0, "pause", MPV_FORMAT_NONE);
     mpv_observe_property(h, 0, "mute", MPV_FORMAT_NONE);
-    mpv_observe_property(h, 0, "volume", MPV_FORMAT_NONE); //ao-volume ?
     mpv_observe_property(h, 0, "sid", MPV_FORMAT_NONE);
     mpv_observe_property(h, 0, "aid", MPV_FORMAT_NODE);
-    mpv_observe_property(h, 0, "dwidth", MPV_FORMAT_NODE);
-    mpv_observe_property(h, 0, "dheight", MPV_FORMAT_NODE);
 
     // because of vpu, we need to implement playlist w/o mpv
     //mpv_observe_property(h, 0, "playlist-pos", MPV_FORMAT_NONE);
@@ -337,6 +376,10 @@ mpv_handle *MpvProxy::mpv_init()
         std::runtime_error("mpv init failed");
     }
 
+    if (headless) {
+        return h;
+    }
+
     //load profile
     auto ol = CompositingManager::get().getBestProfile();
     auto p = ol.begin();
@@ -369,61 +412,46 @@ void MpvProxy::setState(PlayState s)
         _state = s;
         if (_gl_widget) {
             _gl_widget->setPlaying(s != PlayState::Stopped);
+            if (s != PlayState::Playing)
+                _gl_widget->resetFrameTiming();
         }
         emit stateChanged();
     }
 }
 
 
-void MpvProxy::pollingEndOfPlayback()
+void MpvProxy::whenPlaybackEnded(const std::function<void()> &cont)
 {
-    if (_state != Backend::Stopped) {
-        _polling = true;
-        blockSignals(true);
-        stop();
-        auto idle = get_property(_handle, "idle-active").toBool();
-        if (idle) {
-            blockSignals(false);
-            setState(Backend::Stopped);
-            _polling = false;
-            return;
-        }
-
-        while (_state != Backend::Stopped) {
-            mpv_event *ev = mpv_wait_event(_handle, 0.005);
-            if (ev->event_id == MPV_EVENT_NONE)
-                continue;
+    if (_state == Backend::Stopped) {
+        if (cont) cont();
+        return;
+    }
 
-            if (ev->event_id == MPV_EVENT_END_FILE) {
-                qDebug() << "end of playback";
-                blockSignals(false);
-                setState(Backend::Stopped);
-                break;
-            }
-        }
+    if (cont) _endedConts.append(cont);
+    if (_stopping) return;
 
-        _polling = false;
+    _stopping = true;
+    stop();
+    // mpv went idle before we noticed, no END_FILE will follow
+    if (get_property(_handle, "idle-active").toBool()) {
+        setState(Backend::Stopped);
+        _stopping = false;
+        runContinuations(_endedConts);
     }
 }
 
-void MpvProxy::pollingStartOfPlayback()
+void MpvProxy::whenPlaybackStarted(const std::function<void()> &cont)
 {
-    if (_state == Backend::PlayState::Stopped) {
-        _polling = true;
-
-        while (_state == Backend::Stopped) {
-            mpv_event *ev = mpv_wait_event(_handle, 0.005);
-            if (ev->event_id == MPV_EVENT_NONE)
-                continue;
-
-            if (ev->event_id == MPV_EVENT_FILE_LOADED) {
-                qDebug() << "start of playback";
-                setState(Backend::Playing);
-                break;
-            }
-        }
+    if (cont) _startedConts.append(cont);
+}
 
-        _polling = false;
+void MpvProxy::runContinuations(QList<std::function<void()>> &conts)
+{
+    // a continuation may queue new ones
+    auto l = conts;
+    conts.clear();
+    for (const auto &cont : l) {
+        cont();
     }
 }
 
@@ -434,8 +462,9 @@ const PlayingMovieInfo &MpvProxy::playingMovieInfo()
 
 void MpvProxy::handle_mpv_events()
 {
+    // woken up by mpv_callback, only drain what is queued
     while (1) {
-        mpv_event *ev = mpv_wait_event(_handle, 0.0005);
+        mpv_event *ev = mpv_wait_event(_handle, 0);
         if (ev->event_id == MPV_EVENT_NONE)
             break;
 
@@ -497,15 +526,25 @@ void MpvProxy::handle_mpv_events()
                 }
 #endif
             }
+            if (_gl_widget || _headless != HeadlessMode::NoHeadless) {
+                FrameStats::get().reset();
+            }
+            // FILE_LOADED is delivered before the property changes it caused
+            refreshMirror();
             setState(PlayState::Playing); //might paused immediately
             emit fileLoaded();
             qDebug() << QString("rotate metadata: dec %1, out %2")
                      .arg(get_property(_handle, "video-dec-params/rotate").toInt())
                      .arg(get_property(_handle, "video-params/rotate").toInt());
+            runContinuations(_startedConts);
             break;
 
         case MPV_EVENT_VIDEO_RECONFIG: {
+            refreshMirror();
             auto sz = videoSize();
+            if (_swRenderer) {
+                _swRenderer->setFrameSize(sz);
+            }
             if (!sz.isEmpty())
                 emit videoSizeChanged();
             qDebug() << "videoSize " << sz;
@@ -520,14 +559,36 @@ void MpvProxy::handle_mpv_events()
             mpv_event_end_file *ev_ef = (mpv_event_end_file *)ev->data;
             qDebug() << mpv_event_name(ev->event_id) <<
                      "reason " << ev_ef->reason;
+            if (ev_ef->reason == MPV_END_FILE_REASON_EOF && !_stopping
+                    && _queuedFile.isValid()) {
+                // mpv goes on with the prefetched entry, no stop in between
+                _file = _queuedFile;
+                _queuedFile.clear();
+                _startPlayDuration = qMax(resumePosition(_file), 0ll);
+                whenPlaybackStarted([this]() { loadConfiguredSubs(); });
+                emit queuedFileStarted(_file);
+                break;
+            }
+            _queuedFile.clear();
             setState(PlayState::Stopped);
+            _stopping = false;
+            runContinuations(_endedConts);
             break;
         }
 
         case MPV_EVENT_IDLE:
             qDebug() << mpv_event_name(ev->event_id);
+            // a late idle from before a switch that already issued its
+            // loadfile: mpv is busy again, stopping now would end the new
+            // file's continuations and let the playlist advance twice
+            if (!get_property(_handle, "idle-active").toBool()) {
+                qDebug() << "stale idle ignored";
+                break;
+            }
             setState(PlayState::Stopped);
             emit elapsedChanged();
+            _stopping = false;
+            runContinuations(_endedConts);
             break;
 
         default:
@@ -561,9 +622,65 @@ void MpvProxy::processLogMessage(mpv_event_log_message *ev)
     }
 }
 
+void MpvProxy::updateMirror(mpv_event_property *ev)
+{
+    // data is null when the property is unavailable (e.g nothing loaded)
+    double d = 0.0;
+    qint64 i = 0;
+    if (ev->data) {
+        if (ev->format == MPV_FORMAT_DOUBLE) {
+            d = *(double *)ev->data;
+        } else if (ev->format == MPV_FORMAT_INT64) {
+            i = *(int64_t *)ev->data;
+        } else if (ev->format == MPV_FORMAT_FLAG) {
+            i = *(int *)ev->data;
+        }
+    }
+
+    if (!strcmp(ev->name, "time-pos")) {
+        _mirror.timePos.store(d);
+    } else if (!strcmp(ev->name, "duration")) {
+        _mirror.duration.store(d);
+    } else if (!strcmp(ev->name, "volume")) {
+        _mirror.volume.store(d);
+    } else if (!strcmp(ev->name, "pause")) {
+        _mirror.pause.store(i != 0);
+    } else if (!strcmp(ev->name, "dwidth")) {
+        _mirror.dwidth.store(i);
+    } else if (!strcmp(ev->name, "dheight")) {
+        _mirror.dheight.store(i);
+    } else if (!strcmp(ev->name, "video-out-params/rotate")) {
+        _mirror.rotate.store(i);
+    } else if (!strcmp(ev->name, "frame-drop-count")) {
+        _mirror.dropped.store(i);
+        updateFrameStats();
+    } else if (!strcmp(ev->name, "vo-delayed-frame-count")) {
+        _mirror.delayed.store(i);
+        updateFrameStats();
+    } else if (!strcmp(ev->name, "estimated-vf-fps")) {
+        _mirror.vfFps.store(d);
+        updateFrameStats();
+    }
+}
+
+void MpvProxy::updateFrameStats()
+{
+    FrameStats::get().setVoCounters(_mirror.dropped.load(),
+                                    _mirror.delayed.load(), _mirror.vfFps.load());
+}
+
+void MpvProxy::refreshMirror()
+{
+    _mirror.duration.store(get_property(_handle, "duration").toDouble());
+    _mirror.dwidth.store(get_property(_handle, "dwidth").toInt());
+    _mirror.dheight.store(get_property(_handle, "dheight").toInt());
+    _mirror.rotate.store(get_property(_handle, "video-out-params/rotate").toInt());
+}
+
 void MpvProxy::processPropertyChange(mpv_event_property *ev)
 {
     //if (ev->data == NULL) return;
+    updateMirror(ev);
 
     QString name = QString::fromUtf8(ev->name);
     if (name != "time-pos") qDebug() << name;
@@ -572,7 +689,7 @@ void MpvProxy::processPropertyChange(mpv_event_property *ev)
         emit elapsedChanged();
     } else if (name == "volume") {
         emit volumeChanged();
-    } else if (name == "dwidth" || name == "dheight") {
+    } else if (name == "dwidth" || name == "dheight" || name == "video-out-params/rotate") {
         auto sz = videoSize();
         if (!sz.isEmpty())
             emit videoSizeChanged();
@@ -593,7 +710,7 @@ void MpvProxy::processPropertyChange(mpv_event_property *ev)
         //_hideSub = get_property(_handle, "sub-visibility")
     } else if (name == "pause") {
         auto idle = get_property(_handle, "idle-active").toBool();
-        if (get_property(_handle, "pause").toBool()) {
+        if (_mirror.pause.load()) {
             if (!idle)
                 setState(PlayState::Paused);
             else
@@ -696,7 +813,7 @@ void MpvProxy::updateSubStyle(const QString &font, int sz)
 
 void MpvProxy::showEvent(QShowEvent *re)
 {
-    if (!_connectStateChange) {
+    if (!_connectStateChange && window()->windowHandle()) {
         connect(window()->windowHandle(), &QWindow::windowStateChanged, [ = ](Qt::WindowState ws) {
             set_property(_handle, "panscan",
                          (ws != Qt::WindowMaximized && ws != Qt::WindowFullScreen) ? 1.0 : 0.0);
@@ -797,6 +914,8 @@ void MpvProxy::volumeUp()
     QList<QVariant> args = { "add", "volume", 8 };
     qDebug () << args;
     command(_handle, args);
+    // callers read volume() right back, the property event comes later
+    _mirror.volume.store(qMin(_mirror.volume.load() + 8, 240.0));
 }
 
 void MpvProxy::changeVolume(int val)
@@ -804,6 +923,7 @@ void MpvProxy::changeVolume(int val)
     val += 40;
     val = qMin(qMax(val, 40), 240);
     set_property(_handle, "volume", val);
+    _mirror.volume.store(val);
 }
 
 void MpvProxy::volumeDown()
@@ -813,11 +933,12 @@ void MpvProxy::volumeDown()
     QList<QVariant> args = { "add", "volume", -8 };
     qDebug () << args;
     command(_handle, args);
+    _mirror.volume.store(qMax(_mirror.volume.load() - 8, 0.0));
 }
 
 int MpvProxy::volume() const
 {
-    return get_property(_handle, "volume").toInt() - 40;
+    return int(_mirror.volume.load()) - 40;
 }
 
 int MpvProxy::videoRotation() const
@@ -853,25 +974,17 @@ void MpvProxy::toggleMute()
     command(_handle, args);
 }
 
-void MpvProxy::play()
+QStringList MpvProxy::loadOptions(const QUrl &url)
 {
-    QList<QVariant> args = { "loadfile" };
     QStringList opts = { };
 
-    if (_file.isLocalFile()) {
-        args << QFileInfo(_file.toLocalFile()).absoluteFilePath();
-    } else {
-        args << _file.url();
-    }
 #ifndef _LIBDMR_
-    auto cfg = MovieConfiguration::get().queryByUrl(_file);
-    auto key = MovieConfiguration::knownKey2String(ConfigKnownKey::StartPos);
-    if (Settings::get().isSet(Settings::ResumeFromLast) && cfg.contains(key)) {
+    auto cfg = MovieConfiguration::get().queryByUrl(url);
+    if (resumePosition(url) >= 0) {
         opts << QString("start=%1").arg(0);
-        _startPlayDuration = cfg[key].toInt();
     }
 
-    key = MovieConfiguration::knownKey2String(ConfigKnownKey::SubCodepage);
+    auto key = MovieConfiguration::knownKey2String(ConfigKnownKey::SubCodepage);
     if (cfg.contains(key)) {
         opts << QString("sub-codepage=%1").arg(cfg[key].toString());
     }
@@ -884,6 +997,59 @@ void MpvProxy::play()
     if (!_dvdDevice.isEmpty()) {
         opts << QString("dvd-device=%1").arg(_dvdDevice);
     }
+#endif
+
+    return opts;
+}
+
+// -1 if url shouldn't be resumed
+qint64 MpvProxy::resumePosition(const QUrl &url)
+{
+#ifndef _LIBDMR_
+    auto cfg = MovieConfiguration::get().queryByUrl(url);
+    auto key = MovieConfiguration::knownKey2String(ConfigKnownKey::StartPos);
+    if (Settings::get().isSet(Settings::ResumeFromLast) && cfg.contains(key)) {
+        return cfg[key].toInt();
+    }
+#endif
+    return -1;
+}
+
+void MpvProxy::loadConfiguredSubs()
+{
+#ifndef _LIBDMR_
+    auto cfg = MovieConfiguration::get().queryByUrl(_file);
+    auto ext_subs = MovieConfiguration::get().getListByUrl(_file, ConfigKnownKey::ExternalSubs);
+    for (const auto &sub : ext_subs) {
+        if (!QFile::exists(sub)) {
+            MovieConfiguration::get().removeFromListUrl(_file, ConfigKnownKey::ExternalSubs, sub);
+        } else {
+            loadSubtitle(sub);
+        }
+    }
+
+    auto key = MovieConfiguration::knownKey2String(ConfigKnownKey::SubId);
+    if (cfg.contains(key)) {
+        selectSubtitle(cfg[key].toInt());
+    }
+#endif
+}
+
+void MpvProxy::play()
+{
+    QList<QVariant> args = { "loadfile" };
+    QStringList opts = loadOptions(_file);
+
+    if (_file.isLocalFile()) {
+        args << QFileInfo(_file.toLocalFile()).absoluteFilePath();
+    } else {
+        args << _file.url();
+    }
+#ifndef _LIBDMR_
+    auto pos = resumePosition(_file);
+    if (pos >= 0) {
+        _startPlayDuration = pos;
+    }
 
     // hwdec could be disabled by some codecs, so we need to re-enable it
     if (Settings::get().isSet(Settings::HWAccel)) {
@@ -900,33 +1066,53 @@ void MpvProxy::play()
         args << "replace" << opts.join(',');
     }
 
+    // a file that failed to load never reports its start
+    _startedConts.clear();
+    // replacing clears mpv's playlist
+    _queuedFile.clear();
+
     qDebug () << args;
     command(_handle, args);
     set_property(_handle, "pause", _pauseOnStart);
 
 #ifndef _LIBDMR_
-    // by giving a period of time, movie will be loaded and auto-loaded subs are
-    // all ready, then load extra subs from db
+    // once movie is loaded, auto-loaded subs are all ready, then load extra
+    // subs from db
     // this keeps order of subs
-    QTimer::singleShot(100, [this]() {
-        auto cfg = MovieConfiguration::get().queryByUrl(_file);
-        auto ext_subs = MovieConfiguration::get().getListByUrl(_file, ConfigKnownKey::ExternalSubs);
-        for (const auto &sub : ext_subs) {
-            if (!QFile::exists(sub)) {
-                MovieConfiguration::get().removeFromListUrl(_file, ConfigKnownKey::ExternalSubs, sub);
-            } else {
-                loadSubtitle(sub);
-            }
-        }
-
-        auto key = MovieConfiguration::knownKey2String(ConfigKnownKey::SubId);
-        if (cfg.contains(key)) {
-            selectSubtitle(cfg[key].toInt());
-        }
-    });
+    whenPlaybackStarted([this]() { loadConfiguredSubs(); });
 #endif
 }
 
+void MpvProxy::queueNext(const QUrl &url)
+{
+    if (url == _queuedFile)
+        return;
+
+    // drops everything but the current entry
+    command(_handle, QList<QVariant> {"playlist-clear"});
+    _queuedFile.clear();
+
+    if (!url.isValid() || _state == PlayState::Stopped)
+        return;
+
+    QList<QVariant> args = { "loadfile" };
+    if (url.isLocalFile()) {
+        args << QFileInfo(url.toLocalFile()).absoluteFilePath();
+    } else {
+        args << url.url();
+    }
+    args << "append";
+
+    QStringList opts = loadOptions(url);
+    if (opts.size()) {
+        args << opts.join(',');
+    }
+
+    qDebug () << args;
+    command(_handle, args);
+    _queuedFile = url;
+}
+
 
 void MpvProxy::pauseResume()
 {
@@ -938,6 +1124,8 @@ void MpvProxy::pauseResume()
 
 void MpvProxy::stop()
 {
+    // stop clears mpv's playlist as well
+    _queuedFile.clear();
     QList<QVariant> args = { "stop" };
     qDebug () << args;
     command(_handle, args);
@@ -950,7 +1138,7 @@ QImage MpvProxy::takeScreenshot()
 
 void MpvProxy::burstScreenshot()
 {
-    if (_inBurstShotting) {
+    if (_burstExtractor || _inBurstShotting) {
         qWarning() << "already in burst screenshotting mode";
         return;
     }
@@ -958,40 +1146,73 @@ void MpvProxy::burstScreenshot()
     if (state() == PlayState::Stopped)
         return;
 
-    //command(_handle, QList<QVariant> {"revert-seek", "mark"});
-    _posBeforeBurst = get_property(_handle, "time-pos");
+    if (duration() < 35) {
+        emit notifyScreenshot(QImage(), 0);
+        return;
+    }
 
     int d = duration() / 15;
 
     std::random_device rd;
     std::mt19937 g(rd());
     std::uniform_int_distribution<int> uniform_dist(0, d);
-    _burstPoints.clear();
+    QList<qint64> points;
     for (int i = 0; i < 15; i++) {
-        _burstPoints.append(d * i + uniform_dist(g));
+        points.append(qMin(d * i + uniform_dist(g), duration() - 5));
     }
-    _burstStart = 0;
-
-    if (duration() < 35) {
-        emit notifyScreenshot(QImage(), 0);
-        stopBurstScreenshot();
+    qDebug() << "burst span " << points;
+
+    if (!_file.isLocalFile()) {
+        // dvd://, ytdl and other mpv protocols can not be opened by
+        // libavformat, take the shots by seeking the player instead
+        _burstPoints = points;
+        _posBeforeBurst = _mirror.timePos.load();
+        _pausedBeforeBurst = paused();
+        if (!_pausedBeforeBurst) pauseResume();
+        _inBurstShotting = true;
+        QTimer::singleShot(0, this, &MpvProxy::stepBurstScreenshot);
         return;
     }
-    qDebug() << "burst span " << _burstPoints;
 
-    if (!paused()) pauseResume();
-    _inBurstShotting = true;
-    QTimer::singleShot(0, this, &MpvProxy::stepBurstScreenshot);
+    // frames come from separate decoders, playback is left alone
+    _burstExtractor = new BurstExtractor(_file.toLocalFile(), points, videoRotation(), this);
+    connect(_burstExtractor, &BurstExtractor::frameReady,
+            this, &MpvProxy::notifyScreenshot, Qt::QueuedConnection);
+    _burstExtractor->start();
 }
 
-qint64 MpvProxy::nextBurstShootPoint()
+// copies a RGB32 frame into dst rotated clockwise by degree, writing dst
+// row by row so only the reads are strided
+static void copyRotated(const uchar *src, int w, int h, int stride, int degree, QImage &dst)
 {
-    auto next = _burstPoints[_burstStart++];
-    if (next >= duration()) {
-        next = duration() - 5;
+    int dw = dst.width(), dh = dst.height();
+    int step = stride / 4;
+    auto *s = (const quint32 *)src;
+
+    for (int dy = 0; dy < dh; dy++) {
+        auto *d = (quint32 *)dst.scanLine(dy);
+        switch (degree) {
+        case 90:
+            // dst(dx, dy) = src(dy, h - 1 - dx)
+            for (int dx = 0; dx < dw; dx++)
+                d[dx] = s[(h - 1 - dx) * step + dy];
+            break;
+        case 180: {
+            auto *row = s + (h - 1 - dy) * step;
+            for (int dx = 0; dx < dw; dx++)
+                d[dx] = row[w - 1 - dx];
+            break;
+        }
+        case 270:
+            // dst(dx, dy) = src(w - 1 - dy, dx)
+            for (int dx = 0; dx < dw; dx++)
+                d[dx] = s[dx * step + (w - 1 - dy)];
+            break;
+        default:
+            memcpy(d, s + dy * step, dw * 4);
+            break;
+        }
     }
-
-    return next;
 }
 
 QImage MpvProxy::takeOneScreenshot()
@@ -1011,7 +1232,7 @@ QImage MpvProxy::takeOneScreenshot()
 
     Q_ASSERT(res.format == MPV_FORMAT_NODE_MAP);
 
-    int w, h, stride;
+    int w = 0, h = 0, stride = 0;
 
     mpv_node_list *list = res.u.list;
     uchar *data = NULL;
@@ -1032,17 +1253,19 @@ QImage MpvProxy::takeOneScreenshot()
         }
     }
 
-    if (data) {
-        //alpha should be ignored
-        auto img = QImage((const uchar *)data, w, h, stride, QImage::Format_RGB32);
-        img.bits();
-        int rotationdegree = videoRotation();
-        if (rotationdegree) {
-            QMatrix matrix;
-            matrix.rotate(rotationdegree);
-            img = QPixmap::fromImage(img).transformed(matrix, Qt::SmoothTransformation).toImage();
+    if (data && w > 0 && h > 0) {
+        int degree = (videoRotation() % 360 + 360) % 360;
+        if (degree % 90) degree = 0;
+        QSize sz = (degree == 90 || degree == 270) ? QSize(h, w) : QSize(w, h);
+
+        // mpv's buffer dies with res, this is the only copy made. the pooled
+        // image is reused once callers dropped the last one we handed out
+        if (_shotBuffer.size() != sz || !_shotBuffer.isDetached()) {
+            //alpha should be ignored
+            _shotBuffer = QImage(sz, QImage::Format_RGB32);
         }
-        return img;
+        copyRotated(data, w, h, stride, degree, _shotBuffer);
+        return _shotBuffer;
     }
 
     qDebug() << "failed";
@@ -1051,11 +1274,11 @@ QImage MpvProxy::takeOneScreenshot()
 
 void MpvProxy::stepBurstScreenshot()
 {
-    if (!_inBurstShotting) {
+    if (!_inBurstShotting || _burstPoints.isEmpty()) {
         return;
     }
 
-    auto pos = nextBurstShootPoint();
+    auto pos = _burstPoints.takeFirst();
     command(_handle, QList<QVariant> {"seek", pos, "absolute"});
     int tries = 10;
     while (tries) {
@@ -1075,21 +1298,32 @@ void MpvProxy::stepBurstScreenshot()
     }
 
     QImage img = takeOneScreenshot();
+    emit notifyScreenshot(img, elapsed());
     if (img.isNull()) {
-        emit notifyScreenshot(img, elapsed());
         stopBurstScreenshot();
         return;
     }
-    emit notifyScreenshot(img, elapsed());
 
     QTimer::singleShot(0, this, &MpvProxy::stepBurstScreenshot);
 }
 
 void MpvProxy::stopBurstScreenshot()
 {
-    _inBurstShotting = false;
-    //command(_handle, QList<QVariant> {"revert-seek", "mark"});
-    set_property(_handle, "time-pos", _posBeforeBurst);
+    if (_inBurstShotting) {
+        _inBurstShotting = false;
+        _burstPoints.clear();
+        set_property(_handle, "time-pos", _posBeforeBurst);
+        if (!_pausedBeforeBurst) pauseResume();
+        return;
+    }
+
+    if (!_burstExtractor)
+        return;
+
+    disconnect(_burstExtractor, 0, this, 0);
+    _burstExtractor->cancel();
+    _burstExtractor->deleteLater();
+    _burstExtractor = nullptr;
 }
 
 void MpvProxy::seekForward(int secs)
@@ -1130,10 +1364,9 @@ void MpvProxy::seekAbsolute(int pos)
 QSize MpvProxy::videoSize() const
 {
     if (state() == PlayState::Stopped) return QSize(-1, -1);
-    auto sz = QSize(get_property(_handle, "dwidth").toInt(),
-                    get_property(_handle, "dheight").toInt());
+    auto sz = QSize(_mirror.dwidth.load(), _mirror.dheight.load());
 
-    auto r = get_property(_handle, "video-out-params/rotate").toInt();
+    auto r = _mirror.rotate.load();
     if (r == 90 || r == 270) {
         sz.transpose();
     }
@@ -1143,14 +1376,14 @@ QSize MpvProxy::videoSize() const
 
 qint64 MpvProxy::duration() const
 {
-    return get_property(_handle, "duration").value<qint64>();
+    return qint64(_mirror.duration.load());
 }
 
 
 qint64 MpvProxy::elapsed() const
 {
     if (state() == PlayState::Stopped) return 0;
-    return get_property(_handle, "time-pos").value<qint64>();
+    return qint64(_mirror.timePos.load());
 }
 
 void MpvProxy::changeProperty(const QString &name, const QVariant &v)
@@ -38,10 +38,14 @@
 #include <xcb/xproto.h>
 #undef Bool
 #include <mpv/qthelper.hpp>
+#include <functional>
+#include <atomic>
 
 namespace dmr {
 using namespace mpv::qt;
 class MpvGLWidget;
+class BurstExtractor;
+class MpvSwRenderer;
 
 class MpvProxy: public Backend
 {
@@ -58,10 +62,18 @@ public:
         return true;
     }
 
-    // polling until current playback ended
-    void pollingEndOfPlayback();
-    // polling until current playback started
-    void pollingStartOfPlayback();
+    // stops current playback, cont runs from the event loop once mpv
+    // reported its end, or right away if nothing is playing
+    void whenPlaybackEnded(const std::function<void()> &cont);
+    // cont runs once the file being loaded is started
+    void whenPlaybackStarted(const std::function<void()> &cont);
+    // appends url to mpv's own playlist so it's demuxed ahead and started
+    // right after the current file ends, replacing what was queued before.
+    // an empty url drops the queued entry
+    void queueNext(const QUrl &url);
+
+    // software renderer of the HeadlessSoftware mode, null otherwise
+    const MpvSwRenderer *swRenderer() const { return _swRenderer; }
 
     qint64 duration() const override;
     qint64 elapsed() const override;
@@ -126,15 +138,25 @@ protected slots:
 
 signals:
     void has_mpv_events();
+    // mpv moved on to the queued file at the end of the current one
+    void queuedFileStarted(const QUrl &url);
 
 private:
     Handle _handle;
     MpvGLWidget *_gl_widget{nullptr};
+    MpvSwRenderer *_swRenderer {nullptr};
     QWidget *m_parentWidget;
+    // taken once at construction, mpv can't switch its vo afterwards
+    HeadlessMode _headless {Backend::headlessMode()};
+
+    // frame buffer reused by takeOneScreenshot
+    QImage _shotBuffer;
 
+    BurstExtractor *_burstExtractor {nullptr};
+    // seek based burst, for sources libavformat can not open
     bool _inBurstShotting {false};
-    QVariant _posBeforeBurst;
-    qint64 _burstStart {0};
+    bool _pausedBeforeBurst {false};
+    double _posBeforeBurst {0.0};
     QList<qint64> _burstPoints;
 
     qint64 _startPlayDuration {0};
@@ -143,7 +165,28 @@ private:
     PlayingMovieInfo _pmf;
     int _videoRotation {0};
 
-    bool _polling {false};
+    // last values mpv reported for the observed properties, written by
+    // handle_mpv_events and read by the getters without a core round-trip
+    struct PropertyMirror {
+        std::atomic<double> timePos {0.0};
+        std::atomic<double> duration {0.0};
+        std::atomic<int> dwidth {0};
+        std::atomic<int> dheight {0};
+        std::atomic<int> rotate {0};   // video-out-params/rotate
+        std::atomic<bool> pause {false};
+        std::atomic<double> volume {0.0};
+        std::atomic<qint64> dropped {0};  // frame-drop-count
+        std::atomic<qint64> delayed {0};  // vo-delayed-frame-count
+        std::atomic<double> vfFps {0.0};  // estimated-vf-fps
+    } _mirror;
+
+    // continuations of whenPlaybackEnded/whenPlaybackStarted
+    bool _stopping {false};
+    QList<std::function<void()>> _endedConts;
+    QList<std::function<void()>> _startedConts;
+
+    // entry appended by queueNext, still waiting in mpv's playlist
+    QUrl _queuedFile;
 
     bool _externalSubJustLoaded {false};
 
@@ -152,13 +195,19 @@ private:
     bool _pauseOnStart {false};
 
     mpv_handle *mpv_init();
+    QStringList loadOptions(const QUrl &url);
+    qint64 resumePosition(const QUrl &url);
+    void loadConfiguredSubs();
     void processPropertyChange(mpv_event_property *ev);
+    void updateMirror(mpv_event_property *ev);
+    void refreshMirror();
+    void updateFrameStats();
     void processLogMessage(mpv_event_log_message *ev);
     QImage takeOneScreenshot();
     void changeProperty(const QString &name, const QVariant &v);
     void updatePlayingMovieInfo();
     void setState(PlayState s);
-    qint64 nextBurstShootPoint();
+    void runContinuations(QList<std::function<void()>> &conts);
 };
 }
 
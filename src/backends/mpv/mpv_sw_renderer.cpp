@@ -0,0 +1,154 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "mpv_sw_renderer.h"
+
+#include <mpv/client.h>
+#include <mpv/render.h>
+
+namespace dmr {
+
+MpvSwRenderer::MpvSwRenderer(mpv_handle *h, QObject *parent)
+    : QThread(parent)
+{
+#ifdef MPV_RENDER_API_TYPE_SW
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_SW)},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
+    };
+    if (mpv_render_context_create(&_ctx, h, params) < 0) {
+        qWarning() << "can not init mpv sw render context";
+        _ctx = nullptr;
+        return;
+    }
+
+    mpv_render_context_set_update_callback(_ctx, onUpdate, this);
+    start();
+#else
+    Q_UNUSED(h);
+    qWarning() << "libmpv has no sw render api";
+#endif
+}
+
+MpvSwRenderer::~MpvSwRenderer()
+{
+    {
+        QMutexLocker l(&_lock);
+        _quit = true;
+        _cond.wakeAll();
+    }
+    wait();
+
+    if (_ctx) {
+        mpv_render_context_set_update_callback(_ctx, NULL, NULL);
+        mpv_render_context_free(_ctx);
+    }
+}
+
+void MpvSwRenderer::onUpdate(void *ctx)
+{
+    auto *r = static_cast<MpvSwRenderer *>(ctx);
+    QMutexLocker l(&r->_lock);
+    r->_pending = true;
+    r->_cond.wakeOne();
+}
+
+void MpvSwRenderer::setFrameSize(const QSize &sz)
+{
+    QMutexLocker l(&_lock);
+    if (_size == sz) return;
+
+    _size = sz;
+    _pending = true;
+    _cond.wakeOne();
+}
+
+QImage MpvSwRenderer::lastFrame() const
+{
+    QMutexLocker l(&_lock);
+    return _frame;
+}
+
+void MpvSwRenderer::run()
+{
+    QMutexLocker l(&_lock);
+    while (!_quit) {
+        if (!_pending) {
+            _cond.wait(&_lock);
+            continue;
+        }
+
+        _pending = false;
+        auto sz = _size;
+        l.unlock();
+
+        auto flags = mpv_render_context_update(_ctx);
+        if ((flags & MPV_RENDER_UPDATE_FRAME) && !sz.isEmpty()) {
+            renderFrame(sz);
+        }
+
+        l.relock();
+    }
+}
+
+void MpvSwRenderer::renderFrame(const QSize &sz)
+{
+#ifdef MPV_RENDER_API_TYPE_SW
+    if (_back.size() != sz) {
+        // rgb0 is byte ordered, so is RGBX8888 whatever the endianness
+        _back = QImage(sz, QImage::Format_RGBX8888);
+    }
+
+    int size[2] = {sz.width(), sz.height()};
+    size_t stride = _back.bytesPerLine();
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_SW_SIZE, size},
+        {MPV_RENDER_PARAM_SW_FORMAT, const_cast<char *>("rgb0")},
+        {MPV_RENDER_PARAM_SW_STRIDE, &stride},
+        {MPV_RENDER_PARAM_SW_POINTER, _back.bits()},
+        {MPV_RENDER_PARAM_INVALID, nullptr}
+    };
+
+    QElapsedTimer t;
+    t.start();
+    if (mpv_render_context_render(_ctx, params) < 0) {
+        qWarning() << "mpv sw render failed" << sz;
+        return;
+    }
+    _renderUs += t.nsecsElapsed() / 1000;
+    _frames++;
+
+    QMutexLocker l(&_lock);
+    std::swap(_frame, _back);
+#else
+    Q_UNUSED(sz);
+#endif
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_MPV_SW_RENDERER_H
+#define _DMR_MPV_SW_RENDERER_H
+
+#include <QtGui>
+#include <atomic>
+
+struct mpv_handle;
+struct mpv_render_context;
+
+namespace dmr {
+
+/*
+   class MpvSwRenderer
+   renders mpv's output with the software render api into memory on its own
+   thread, for the headless backend. nothing is displayed, the last frame
+   and the counters are there to be inspected by test harnesses.
+   needs a libmpv built with the sw render api, isValid() tells.
+*/
+class MpvSwRenderer: public QThread
+{
+    Q_OBJECT
+public:
+    explicit MpvSwRenderer(mpv_handle *h, QObject *parent = nullptr);
+    ~MpvSwRenderer();
+
+    bool isValid() const { return _ctx != nullptr; }
+
+    // frames are rendered at this size, nothing is rendered until it's set
+    void setFrameSize(const QSize &sz);
+
+    QImage lastFrame() const;
+    qint64 framesRendered() const { return _frames.load(); }
+    // accumulated time spent in mpv_render_context_render
+    qint64 renderTimeUs() const { return _renderUs.load(); }
+
+protected:
+    void run() override;
+
+private:
+    mpv_render_context *_ctx {nullptr};
+
+    mutable QMutex _lock;
+    QWaitCondition _cond;
+    bool _pending {false};
+    bool _quit {false};
+    QSize _size;
+    QImage _frame;
+    // rendered into by run() only, swapped with _frame when done
+    QImage _back;
+
+    std::atomic<qint64> _frames {0};
+    std::atomic<qint64> _renderUs {0};
+
+    static void onUpdate(void *ctx);
+    void renderFrame(const QSize &sz);
+};
+
+}
+
+#endif /* ifndef _DMR_MPV_SW_RENDERER_H */
+
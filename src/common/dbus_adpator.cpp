@@ -28,6 +28,7 @@
  * files in the program, then also delete it here.
  */
 #include "dbus_adpator.h"
+#include "frame_stats.h"
 
 ApplicationAdaptor::ApplicationAdaptor(MainWindow* mw)
     :QDBusAbstractAdaptor(mw), _mw(mw) 
@@ -52,6 +53,16 @@ void ApplicationAdaptor::openFile(const QString& file)
     _mw->play(url);
 }
 
+QVariantMap ApplicationAdaptor::frameStats()
+{
+    return FrameStats::get().snapshot();
+}
+
+void ApplicationAdaptor::setFrameStatsOverlay(bool on)
+{
+    FrameStats::get().setOverlayVisible(on);
+}
+
 QVariant ApplicationAdaptor::redDBusProperty(const QString &service, const QString &path, const QString &interface, const char *propert)
 {
     // 创建QDBusInterface接口
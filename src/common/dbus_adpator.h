@@ -48,6 +48,10 @@ public slots:
     void openFile(const QString& url);
     void openFiles(const QStringList& list);
 
+    // gl renderer timing, see FrameStats
+    QVariantMap frameStats();
+    void setFrameStatsOverlay(bool on);
+
 private:
     MainWindow *_mw {nullptr};
 };
@@ -162,16 +162,26 @@ QString Settings::screenshotLocation()
     return save_path;
 }
 
+// the translated templates end with .jpg, swapped for the configured format
+static QString withScreenshotFormat(QString path)
+{
+    auto fmt = Settings::get().internalOption("screenshot_format").toString().toLower();
+    if (!fmt.isEmpty() && fmt != "jpg" && path.endsWith(".jpg")) {
+        path.replace(path.size() - 3, 3, fmt);
+    }
+    return path;
+}
+
 QString Settings::screenshotNameTemplate()
 {
-    return tr("%1/Movie%2.jpg").arg(screenshotLocation())
-        .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss"));
+    return withScreenshotFormat(tr("%1/Movie%2.jpg").arg(screenshotLocation())
+        .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss")));
 }
 
 QString Settings::screenshotNameSeqTemplate()
 {
-    return tr("%1/Movie%2(%3).jpg").arg(screenshotLocation())
-        .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss"));
+    return withScreenshotFormat(tr("%1/Movie%2(%3).jpg").arg(screenshotLocation())
+        .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss")));
 }
 
 void Settings::setGeneralOption(const QString &opt, const QVariant &v)
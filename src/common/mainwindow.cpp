@@ -44,6 +44,8 @@
 #include "player_engine.h"
 #include "url_dialog.h"
 #include "movie_progress_indicator.h"
+#include "playback_clock.h"
+#include "screenshot_writer.h"
 #include "options.h"
 #include "titlebar.h"
 #include "utils.h"
@@ -560,7 +562,7 @@ private:
         if (keep_ratio) {
             auto sz = mw->engine()->videoSize();
             if (sz.isEmpty()) {
-                const auto &mi = mw->engine()->playlist().currentInfo().mi;
+                auto mi = mw->engine()->playlist().currentInfo().mi;
                 sz = QSize(mi.width, mi.height);
             }
 
@@ -787,10 +789,16 @@ MainWindow::MainWindow(QWidget *parent)
         }
     });*/
 
+    connect(&ScreenshotWriter::get(), &ScreenshotWriter::saved,
+            this, &MainWindow::onScreenshotSaved);
+    connect(&ScreenshotWriter::get(), &ScreenshotWriter::batchSaved,
+            this, &MainWindow::onScreenshotBatchSaved);
+
     _progIndicator = new MovieProgressIndicator(this);
     _progIndicator->setVisible(false);
-    connect(_engine, &PlayerEngine::elapsedChanged, [ = ]() {
-        _progIndicator->updateMovieProgress(_engine->duration(), _engine->elapsed());
+    _engine->clock().subscribe(_progIndicator, PlaybackClock::LabelRate,
+    [ = ](const PlaybackClock::Snapshot & s) {
+        _progIndicator->updateMovieProgress(s.duration, s.elapsed);
     });
 
     // mini ui
@@ -917,7 +925,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(_engine, &PlayerEngine::fileLoaded, [ = ]() {
         if (windowState() == Qt::WindowNoState && _lastRectInNormalMode.isValid()) {
-            const auto &mi = _engine->playlist().currentInfo().mi;
+            auto mi = _engine->playlist().currentInfo().mi;
             _lastRectInNormalMode.setSize({mi.width, mi.height});
         }
         this->resizeByConstraints();
@@ -1335,6 +1343,10 @@ MainWindow::~MainWindow()
     disconnect(_engine, 0, 0, 0);
     disconnect(&_engine->playlist(), 0, 0, 0);
 
+    // screenshots still being encoded would be lost on exit
+    disconnect(&ScreenshotWriter::get(), 0, this, 0);
+    ScreenshotWriter::get().waitForDone();
+
     if (_lastCookie > 0) {
         utils::UnInhibitStandby(_lastCookie);
         qDebug() << "uninhibit cookie" << _lastCookie;
@@ -1876,10 +1888,9 @@ void MainWindow::requestAction(ActionFactory::ActionKind kd, bool fromUI,
         if (fi.isDir() && fi.exists()) {
             Settings::get().setGeneralOption("last_open_path", fi.path());
 
-            const auto &urls = _engine->addPlayDir(name);
-            if (urls.size()) {
-                _engine->playByName(QUrl("playlist://0"));
-            }
+            // playback starts on the folder's first file by name once it is listed
+            _engine->scanPlayDir(name);
+            _engine->playByName(QUrl::fromLocalFile(name));
         }
         break;
     }
@@ -2428,69 +2439,11 @@ void MainWindow::requestAction(ActionFactory::ActionKind kd, bool fromUI,
     case ActionFactory::ActionKind::Screenshot: {
         auto img = _engine->takeScreenshot();
 
+        // encoded in background, onScreenshotSaved reports the result
         QString filePath = Settings::get().screenshotNameTemplate();
-        bool success = false;
         if (img.isNull())
             qDebug() << __func__ << "pixmap is null";
-        else
-            success = img.save(filePath);
-
-#ifdef USE_SYSTEM_NOTIFY
-        // Popup notify.
-        QDBusInterface notification("org.freedesktop.Notifications",
-                                    "/org/freedesktop/Notifications",
-                                    "org.freedesktop.Notifications",
-                                    QDBusConnection::sessionBus());
-
-        QStringList actions;
-        actions << "_open" << tr("View");
-
-
-        QVariantMap hints;
-        hints["x-deepin-action-_open"] = QString("xdg-open,%1").arg(filePath);
-
-
-        QList<QVariant> arg;
-        arg << (QCoreApplication::applicationName())                 // appname
-            << ((unsigned int) 0)                                    // id
-            << QString("deepin-movie")                               // icon
-            << tr("Film screenshot")                                // summary
-            << QString("%1 %2").arg(tr("Saved to")).arg(filePath) // body
-            << actions                                               // actions
-            << hints                                                 // hints
-            << (int) -1;                                             // timeout
-        notification.callWithArgumentList(QDBus::AutoDetect, "Notify", arg);
-
-#else
-
-#define POPUP_ADAPTER(icon, text)  do { \
-popup->setIcon(icon);\
-DFontSizeManager::instance()->bind(this, DFontSizeManager::T6);\
-QFont font = DFontSizeManager::instance()->get(DFontSizeManager::T6);\
-QFontMetrics fm(font);\
-auto w = fm.boundingRect(text).width();\
-popup->setMessage(text);\
-popup->resize(w + 70, 52);\
-popup->move((width() - popup->width()) / 2, height() - 127);\
-popup->show();\
-} while (0)
-
-//        if (!popup) {
-//            popup = new DFloatingMessage(DFloatingMessage::TransientType, this);
-//        }
-        if (success) {
-            const QIcon icon = QIcon(":/resources/icons/icon_toast_sucess.svg");
-            QString text = QString(tr("The screenshot is saved"));
-            POPUP_ADAPTER(icon, text);
-        } else {
-            const QIcon icon = QIcon(":/resources/icons/icon_toast_fail.svg");
-            QString text = QString(tr("Failed to save the screenshot"));
-            POPUP_ADAPTER(icon, text);
-        }
-
-#undef POPUP_ADAPTER
-
-#endif
+        ScreenshotWriter::get().save(img, filePath);
         break;
     }
 
@@ -2548,20 +2501,78 @@ popup->show();\
     }
 }
 
-void MainWindow::onBurstScreenshot(const QImage &frame, qint64 timestamp)
+void MainWindow::onScreenshotBatchSaved(int batch, const QStringList &paths, int failed)
+{
+    qDebug() << __func__ << batch << paths.size() << "failed" << failed;
+    if (paths.isEmpty())
+        return;
+
+    // a burst lands in one folder, point the notification there
+    onScreenshotSaved(QFileInfo(paths.first()).absolutePath(), failed == 0);
+}
+
+void MainWindow::onScreenshotSaved(const QString &filePath, bool success)
 {
+#ifdef USE_SYSTEM_NOTIFY
+    // Popup notify.
+    QDBusInterface notification("org.freedesktop.Notifications",
+                                "/org/freedesktop/Notifications",
+                                "org.freedesktop.Notifications",
+                                QDBusConnection::sessionBus());
+
+    QStringList actions;
+    actions << "_open" << tr("View");
+
+
+    QVariantMap hints;
+    hints["x-deepin-action-_open"] = QString("xdg-open,%1").arg(filePath);
+
+
+    QList<QVariant> arg;
+    arg << (QCoreApplication::applicationName())                 // appname
+        << ((unsigned int) 0)                                    // id
+        << QString("deepin-movie")                               // icon
+        << tr("Film screenshot")                                // summary
+        << QString("%1 %2").arg(tr("Saved to")).arg(filePath) // body
+        << actions                                               // actions
+        << hints                                                 // hints
+        << (int) -1;                                             // timeout
+    notification.callWithArgumentList(QDBus::AutoDetect, "Notify", arg);
+
+#else
+
 #define POPUP_ADAPTER(icon, text)  do { \
-        popup->setIcon(icon);\
-        DFontSizeManager::instance()->bind(this, DFontSizeManager::T6);\
-        QFont font = DFontSizeManager::instance()->get(DFontSizeManager::T6);\
-        QFontMetrics fm(font);\
-        auto w = fm.boundingRect(text).width();\
-        popup->setMessage(text);\
-        popup->resize(w + 70, 52);\
-        popup->move((width() - popup->width()) / 2, height() - 127);\
-        popup->show();\
-    } while (0)
+popup->setIcon(icon);\
+DFontSizeManager::instance()->bind(this, DFontSizeManager::T6);\
+QFont font = DFontSizeManager::instance()->get(DFontSizeManager::T6);\
+QFontMetrics fm(font);\
+auto w = fm.boundingRect(text).width();\
+popup->setMessage(text);\
+popup->resize(w + 70, 52);\
+popup->move((width() - popup->width()) / 2, height() - 127);\
+popup->show();\
+} while (0)
+
+//        if (!popup) {
+//            popup = new DFloatingMessage(DFloatingMessage::TransientType, this);
+//        }
+    if (success) {
+        const QIcon icon = QIcon(":/resources/icons/icon_toast_sucess.svg");
+        QString text = QString(tr("The screenshot is saved"));
+        POPUP_ADAPTER(icon, text);
+    } else {
+        const QIcon icon = QIcon(":/resources/icons/icon_toast_fail.svg");
+        QString text = QString(tr("Failed to save the screenshot"));
+        POPUP_ADAPTER(icon, text);
+    }
+
+#undef POPUP_ADAPTER
+
+#endif
+}
 
+void MainWindow::onBurstScreenshot(const QImage &frame, qint64 timestamp)
+{
     qDebug() << _burstShoots.size();
     if (!frame.isNull()) {
         auto msg = QString(tr("Taking the screenshots, please wait..."));
@@ -2579,32 +2590,24 @@ void MainWindow::onBurstScreenshot(const QImage &frame, qint64 timestamp)
 
         if (frame.isNull()) {
             _burstShoots.clear();
-            if (!_pausedBeforeBurst)
-                _engine->pauseResume();
             return;
         }
 
+        // frames are grabbed in parallel and arrive out of order
+        std::sort(_burstShoots.begin(), _burstShoots.end(),
+        [](const QPair<QImage, qint64> &a, const QPair<QImage, qint64> &b) {
+            return a.second < b.second;
+        });
+
         BurstScreenshotsDialog bsd(_engine->playlist().currentInfo());
         bsd.updateWithFrames(_burstShoots);
         auto ret = bsd.exec();
         qDebug() << "BurstScreenshot done";
 
         _burstShoots.clear();
-        if (!_pausedBeforeBurst)
-            _engine->pauseResume();
 
-        if (ret == QDialog::Accepted) {
-            auto poster_path = bsd.savedPosterPath();
-            if (QFileInfo::exists(poster_path)) {
-                const QIcon icon = QIcon(":/resources/icons/icon_toast_sucess.svg");
-                QString text = QString(tr("The screenshot is saved"));
-                POPUP_ADAPTER(icon, text);
-            } else {
-                const QIcon icon = QIcon(":/resources/icons/icon_toast_fail.svg");
-                QString text = QString(tr("Failed to save the screenshot"));
-                POPUP_ADAPTER(icon, text);
-            }
-        }
+        // the poster is written in background, onScreenshotSaved reports it
+        qDebug() << "poster" << (ret == QDialog::Accepted ? bsd.savedPosterPath() : QString());
     }
 }
 
@@ -2614,8 +2617,6 @@ void MainWindow::startBurstShooting()
     _toolbox->setEnabled(false);
     if (_listener) _listener->setEnabled(false);
 
-    _pausedBeforeBurst = _engine->paused();
-
     connect(_engine, &PlayerEngine::notifyScreenshot, this, &MainWindow::onBurstScreenshot);
     _engine->burstScreenshot();
 }
@@ -3113,7 +3114,7 @@ void MainWindow::resizeByConstraints(bool forceCentered)
     qDebug() << __func__;
     updateWindowTitle();
 
-    const auto &mi = _engine->playlist().currentInfo().mi;
+    auto mi = _engine->playlist().currentInfo().mi;
     auto sz = _engine->videoSize();
 #ifdef __mips__
     //3.26修改，初始分辨率大于1080P时缩小一半
@@ -3230,7 +3231,7 @@ void MainWindow::resizeEvent(QResizeEvent *ev)
 void MainWindow::updateWindowTitle()
 {
     if (_engine->state() != PlayerEngine::Idle) {
-        const auto &mi = _engine->playlist().currentInfo().mi;
+        auto mi = _engine->playlist().currentInfo().mi;
         auto title = _titlebar->fontMetrics().elidedText(mi.title,
                                                          Qt::ElideMiddle, _titlebar->contentsRect().width() - 400);
         _titlebar->setTitletxt(title);
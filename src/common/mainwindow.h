@@ -216,6 +216,8 @@ protected slots:
 
     void startBurstShooting();
     void onBurstScreenshot(const QImage &frame, qint64 timestamp);
+    void onScreenshotSaved(const QString &filePath, bool success);
+    void onScreenshotBatchSaved(int batch, const QStringList &paths, int failed);
     void delayedMouseReleaseHandler();
     void onDvdData(const QString &title);
 
@@ -276,7 +278,6 @@ private:
 
     QList<QPair<QImage, qint64>> _burstShoots;
     bool _inBurstShootMode {false};
-    bool _pausedBeforeBurst {false};
 
 #ifdef __mips__
     QAbstractButton *_miniPlayBtn {nullptr};
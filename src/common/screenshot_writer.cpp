@@ -0,0 +1,177 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "screenshot_writer.h"
+#include "dmr_settings.h"
+
+#include <QtConcurrent>
+
+namespace dmr {
+
+static std::atomic<ScreenshotWriter*> _instance { nullptr };
+static QMutex _instLock;
+
+ScreenshotWriter& ScreenshotWriter::get()
+{
+    if (_instance == nullptr) {
+        QMutexLocker lock(&_instLock);
+        if (_instance == nullptr) {
+            _instance = new ScreenshotWriter;
+        }
+    }
+
+    return *_instance;
+}
+
+ScreenshotWriter::ScreenshotWriter()
+{
+    // encoders are memory hungry on 4k frames, two are plenty for
+    // a burst of saves
+    _pool.setMaxThreadCount(2);
+
+    setPngCompression(Settings::get().internalOption("screenshot_png_compression").toInt());
+    setJpegQuality(Settings::get().internalOption("screenshot_jpeg_quality").toInt());
+    setWebpQuality(Settings::get().internalOption("screenshot_webp_quality").toInt());
+}
+
+void ScreenshotWriter::setPngCompression(int level)
+{
+    _pngCompression.store(qBound(0, level, 9));
+}
+
+void ScreenshotWriter::setJpegQuality(int quality)
+{
+    _jpegQuality.store(qBound(0, quality, 100));
+}
+
+void ScreenshotWriter::setWebpQuality(int quality)
+{
+    _webpQuality.store(qBound(0, quality, 100));
+}
+
+void ScreenshotWriter::save(const QImage& img, const QString& path)
+{
+    if (img.isNull()) {
+        qWarning() << __func__ << "null image for" << path;
+        emit saved(path, false);
+        return;
+    }
+
+    _pending++;
+    // img is shared with the caller, not copied
+    QtConcurrent::run(&_pool, [=]() {
+        bool ok = write(img, path);
+        _pending--;
+        emit saved(path, ok);
+    });
+}
+
+int ScreenshotWriter::saveBatch(const QList<QPair<QImage, QString>>& shots)
+{
+    struct Batch {
+        int id;
+        QStringList paths;
+        std::atomic<int> left;
+        std::atomic<int> failed;
+    };
+
+    QSharedPointer<Batch> b(new Batch);
+    b->id = _nextBatch++;
+    b->left = shots.size();
+    b->failed = 0;
+    for (const auto& s: shots) b->paths.append(s.second);
+
+    if (shots.isEmpty()) {
+        emit batchSaved(b->id, b->paths, 0);
+        return b->id;
+    }
+
+    // whoever finishes the last file reports the whole batch
+    auto done = [=](bool ok) {
+        if (!ok) b->failed++;
+        if (--b->left == 0)
+            emit batchSaved(b->id, b->paths, b->failed.load());
+    };
+
+    for (const auto& s: shots) {
+        if (s.first.isNull()) {
+            qWarning() << __func__ << "null image for" << s.second;
+            done(false);
+            continue;
+        }
+
+        _pending++;
+        auto img = s.first;
+        auto path = s.second;
+        QtConcurrent::run(&_pool, [=]() {
+            bool ok = write(img, path);
+            _pending--;
+            done(ok);
+        });
+    }
+
+    return b->id;
+}
+
+void ScreenshotWriter::waitForDone()
+{
+    _pool.waitForDone();
+}
+
+bool ScreenshotWriter::write(const QImage& img, const QString& path)
+{
+    QByteArray format = QFileInfo(path).suffix().toLower().toLatin1();
+    if (format == "jpeg") format = "jpg";
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "screenshot: can not open" << path << f.errorString();
+        return false;
+    }
+
+    QImageWriter w(&f, format);
+    if (format == "png") {
+        // qt's png handler maps quality [0, 100] onto zlib level [9, 0]
+        w.setQuality(100 - (_pngCompression.load() * 91 + 8) / 9);
+    } else if (format == "jpg") {
+        w.setQuality(_jpegQuality.load());
+    } else if (format == "webp") {
+        w.setQuality(_webpQuality.load());
+    }
+
+    if (!w.write(img)) {
+        qWarning() << "screenshot: encoding" << path << "failed:" << w.errorString();
+        f.cancelWriting();
+        return false;
+    }
+
+    return f.commit();
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_SCREENSHOT_WRITER_H
+#define _DMR_SCREENSHOT_WRITER_H
+
+#include <QtGui>
+#include <atomic>
+
+namespace dmr {
+
+/*
+   class ScreenshotWriter
+   encodes and writes screenshots on a small pool of encoder threads, so
+   the gui never waits for a png or jpeg encoder. the format follows the
+   suffix of the path. files are written through QSaveFile and appear
+   complete or not at all. saves beyond the pool size queue up.
+   a batch (e.g. a burst) reports once, with batchSaved, instead of
+   once per file.
+*/
+class ScreenshotWriter: public QObject {
+    Q_OBJECT
+public:
+    static ScreenshotWriter& get();
+
+    void save(const QImage& img, const QString& path);
+    // returns the batch id passed to batchSaved
+    int saveBatch(const QList<QPair<QImage, QString>>& shots);
+    // blocks until every queued save is on disk
+    void waitForDone();
+    // pending and running saves
+    int pending() const { return _pending.load(); }
+
+    // 0 (fastest) - 9 (smallest)
+    void setPngCompression(int level);
+    // 0 - 100
+    void setJpegQuality(int quality);
+    void setWebpQuality(int quality);
+
+signals:
+    // emitted from an encoder thread
+    void saved(const QString& path, bool ok);
+    // emitted from an encoder thread when the last file of a batch is done
+    void batchSaved(int batch, const QStringList& paths, int failed);
+
+private:
+    QThreadPool _pool;
+    std::atomic<int> _pending {0};
+    std::atomic<int> _nextBatch {1};
+    std::atomic<int> _pngCompression {6};
+    std::atomic<int> _jpegQuality {90};
+    std::atomic<int> _webpQuality {90};
+
+    ScreenshotWriter();
+    bool write(const QImage& img, const QString& path);
+};
+
+}
+
+#endif /* ifndef _DMR_SCREENSHOT_WRITER_H */
@@ -28,10 +28,12 @@
  * files in the program, then also delete it here.
  */
 #include "thumbnail_worker.h"
+#include "dmr_settings.h"
 #include <atomic>
 #include <mutex>
+#include <algorithm>
 
-#define SIZE_THRESHOLD (10 * 1<<20)
+#define SIZE_THRESHOLD (32 * 1<<20)
 
 namespace dmr {
 static std::atomic<ThumbnailWorker*> _instance { nullptr };
@@ -53,27 +55,94 @@ ThumbnailWorker& ThumbnailWorker::get()
     return *_instance;
 }
 
+// _thumbLock must be held
+int ThumbnailWorker::snapToKeyframe(const QUrl& url, int secs) const
+{
+    if (url != _indexedUrl || _keyframes.isEmpty()) return secs;
+
+    qint64 ms = secs * 1000LL;
+    auto p = std::lower_bound(_keyframes.cbegin(), _keyframes.cend(), ms);
+    if (p == _keyframes.cend()) {
+        p--;
+    } else if (p != _keyframes.cbegin() && ms - *(p - 1) <= *p - ms) {
+        p--;
+    }
+    return *p / 1000;
+}
+
 bool ThumbnailWorker::isThumbGenerated(const QUrl& url, int secs)
 {
     QMutexLocker lock(&_thumbLock);
-    if (!_cache.contains(url)) return false;
-
-    const auto& l = _cache[url];
-    return l.contains(secs);
+    secs = snapToKeyframe(url, secs);
+    auto p = _cache.constFind(url);
+    return p != _cache.cend() && p->contains(secs);
 }
 
 QPixmap ThumbnailWorker::getThumb(const QUrl& url, int secs)
 {
     QMutexLocker lock(&_thumbLock);
-    QPixmap pm;
+    secs = snapToKeyframe(url, secs);
+    auto p = _cache.find(url);
+    if (p == _cache.end()) return QPixmap();
 
-    if (_cache.contains(url)) {
-//        auto p = _cache[url].find(secs);
-//        pm = *p;
-        pm = _cache[url].value(secs);
+    auto e = p->find(secs);
+    if (e == p->end()) return QPixmap();
+
+    // hovered again, move to the front
+    _lru.splice(_lru.begin(), _lru, e->pos);
+    return e->pm;
+}
+
+void ThumbnailWorker::setCacheBudget(qint64 bytes)
+{
+    QMutexLocker lock(&_thumbLock);
+    _stats.budget = bytes > 0 ? bytes : SIZE_THRESHOLD;
+    evict();
+}
+
+ThumbnailWorker::CacheStats ThumbnailWorker::cacheStats()
+{
+    QMutexLocker lock(&_thumbLock);
+    auto st = _stats;
+    st.entries = _lru.size();
+    return st;
+}
+
+// _thumbLock must be held
+void ThumbnailWorker::insertCache(const QUrl& url, int secs, const QPixmap& pm)
+{
+    auto& group = _cache[url];
+    auto p = group.find(secs);
+    if (p != group.end()) {
+        _stats.bytes -= p->bytes;
+        _lru.erase(p->pos);
+        group.erase(p);
     }
 
-    return pm;
+    _lru.push_front(qMakePair(url, secs));
+    CacheEntry e { pm, (qint64)pm.width() * pm.height() * pm.depth() / 8, _lru.begin() };
+    group.insert(secs, e);
+    _stats.bytes += e.bytes;
+
+    evict();
+}
+
+// _thumbLock must be held
+void ThumbnailWorker::evict()
+{
+    while (_stats.bytes > _stats.budget && _lru.size() > 1) {
+        const auto& key = _lru.back();
+        auto p = _cache.find(key.first);
+        if (p != _cache.end()) {
+            _stats.bytes -= p->value(key.second).bytes;
+            p->remove(key.second);
+            if (p->isEmpty()) {
+                _cache.erase(p);
+            }
+        }
+        _lru.pop_back();
+        _stats.evictions++;
+    }
 }
 
 
@@ -88,32 +157,20 @@ void ThumbnailWorker::requestThumb(const QUrl& url, int secs)
 
 ThumbnailWorker::ThumbnailWorker()
 {
-    thumber.setThumbnailSize(thumbSize().width() * qApp->devicePixelRatio());
-    thumber.setMaintainAspectRatio(true);
+    _stats.budget = SIZE_THRESHOLD;
+    auto mb = Settings::get().internalOption("preview_cache_size").toLongLong();
+    if (mb > 0) {
+        _stats.budget = mb << 20;
+    }
 }
 
-QPixmap ThumbnailWorker::genThumb(const QUrl& url, int secs)
+QPixmap ThumbnailWorker::genThumb(const QUrl& url, qint64 ms)
 {
     auto dpr = qApp->devicePixelRatio();
-    QPixmap pm;
-    pm.setDevicePixelRatio(dpr);
-
-    QTime d(0, 0, 0);
-    d = d.addSecs(secs);
-    thumber.setSeekTime(d.toString("hh:mm:ss").toStdString());
-    auto file = QFileInfo(url.toLocalFile()).absoluteFilePath();
-    try {
-        std::vector<uint8_t> buf;
-        thumber.generateThumbnail(file.toUtf8().toStdString(),
-                ThumbnailerImageType::Png, buf);
-
-        auto img = QImage::fromData(buf.data(), buf.size(), "png");
-
-        pm = QPixmap::fromImage(img.scaled(thumbSize() * dpr, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation));
-        pm.setDevicePixelRatio(dpr);
-    } catch (const std::logic_error&) {
-    }
+    auto img = _grabber.grab(ms, thumbSize() * dpr, Qt::KeepAspectRatioByExpanding);
 
+    auto pm = QPixmap::fromImage(img);
+    pm.setDevicePixelRatio(dpr);
     return pm;
 }
 
@@ -136,32 +193,40 @@ void ThumbnailWorker::run()
         }
 
         if (_quit.load()) break;
-        
-        {
+
+        if (w.first != _indexedUrl) {
+            auto file = QFileInfo(w.first.toLocalFile()).absoluteFilePath();
+            _grabber.open(file);
+
             QMutexLocker lock(&_thumbLock);
-            //TODO: optimize: need a lru map
-            if (_cacheSize > SIZE_THRESHOLD) {
-                qDebug() << "thumb cache size exceeds maximum, clean up";
-                _cache.clear();
-                _cacheSize = 0;
-            }
+            _indexedUrl = w.first;
+            _keyframes = _grabber.keyframes();
         }
 
-        if (!isThumbGenerated(w.first, w.second)) {
-            auto pm = genThumb(w.first, w.second);
+        if (isThumbGenerated(w.first, w.second)) {
+            QMutexLocker lock(&_thumbLock);
+            _stats.hits++;
+        } else {
+            auto ms = _grabber.nearestKeyframe(w.second * 1000LL);
+            auto pm = genThumb(w.first, ms);
 
             QMutexLocker lock(&_thumbLock);
-            _cache[w.first].insert(w.second, pm);
-            _cacheSize += pm.width() * pm.height() * (pm.hasAlpha() ? 4 : 3);
+            _stats.misses++;
+            insertCache(w.first, snapToKeyframe(w.first, w.second), pm);
 
             QTime d(0, 0, 0);
-            d = d.addSecs(w.second);
-            qDebug() << "thumb for " << w.first << d.toString("hh:mm:ss");
+            d = d.addMSecs(ms);
+            qDebug() << "thumb for " << w.first << d.toString("hh:mm:ss.zzz");
         }
 
         emit thumbGenerated(w.first, w.second);
     }
 
+    auto st = cacheStats();
+    qDebug() << "thumb cache: hits" << st.hits << "misses" << st.misses
+             << "evictions" << st.evictions << "entries" << st.entries
+             << "bytes" << st.bytes << "/" << st.budget;
+    _grabber.close();
     _wq.clear();
 }
 
@@ -31,22 +31,38 @@
 #define _DMR_THUMBNAIL_WORKER_H 
 
 #include <QtWidgets>
-#include <libffmpegthumbnailer/videothumbnailer.h>
+#include <list>
+
+#include "frame_grabber.h"
 
 namespace dmr {
-using namespace ffmpegthumbnailer;
 
 class ThumbnailWorker: public QThread {
     Q_OBJECT
 public:
+    struct CacheStats {
+        qint64 hits {0};
+        qint64 misses {0};
+        qint64 evictions {0};
+        qint64 bytes {0};
+        qint64 budget {0};
+        int entries {0};
+    };
+
     static ThumbnailWorker& get();
 
     // expected size for ui
     static QSize thumbSize() { return {178, 101}; }
 
+    // secs are snapped to the nearest keyframe of url once it's indexed,
+    // so nearby hover positions share one thumb
     bool isThumbGenerated(const QUrl& url, int secs);
     QPixmap getThumb(const QUrl& url, int secs);
 
+    // least recently hovered thumbs are evicted beyond this many bytes
+    void setCacheBudget(qint64 bytes);
+    CacheStats cacheStats();
+
     void stop() { _quit.store(1); quit(); }
 
 public slots:
@@ -56,15 +72,31 @@ signals:
     void thumbGenerated(const QUrl& url, int secs);
 
 private:
+    using CacheKey = QPair<QUrl, int>;
+    struct CacheEntry {
+        QPixmap pm;
+        qint64 bytes;
+        std::list<CacheKey>::iterator pos; // in _lru
+    };
+
     QList<QPair<QUrl, int>> _wq;
-    QHash<QUrl, QMap<int, QPixmap>> _cache;
-    VideoThumbnailer thumber;
+    // thumbs grouped per url, _lru keeps (url, secs) from most to least
+    // recently used
+    QHash<QUrl, QHash<int, CacheEntry>> _cache;
+    std::list<CacheKey> _lru;
+    // decoder stays open for the last hovered file
+    FrameGrabber _grabber;
+    QUrl _indexedUrl;
+    QVector<qint64> _keyframes;
     QAtomicInt _quit{0};
-    qint64 _cacheSize {0};
+    CacheStats _stats;
 
     ThumbnailWorker();
     void run() override;
-    QPixmap genThumb(const QUrl& url, int secs);
+    QPixmap genThumb(const QUrl& url, qint64 ms);
+    int snapToKeyframe(const QUrl& url, int secs) const;
+    void insertCache(const QUrl& url, int secs, const QPixmap& pm);
+    void evict();
 };
 
 }
@@ -0,0 +1,99 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "burst_extractor.h"
+#include "frame_grabber.h"
+
+namespace dmr {
+
+BurstExtractor::BurstExtractor(const QString &file, const QList<qint64> &points,
+                               int rotation, QObject *parent)
+    : QThread(parent), _file(file), _points(points), _rotation(rotation)
+{
+    _pool.setMaxThreadCount(qMax(1, qMin(QThread::idealThreadCount(), _points.size())));
+}
+
+BurstExtractor::~BurstExtractor()
+{
+    cancel();
+    wait();
+}
+
+void BurstExtractor::cancel()
+{
+    _cancel.store(1);
+}
+
+void BurstExtractor::run()
+{
+    int workers = _pool.maxThreadCount();
+
+    // worker w takes points w, w + workers, ... so every decoder only
+    // seeks forward
+    QList<QFuture<void>> futures;
+    for (int w = 0; w < workers; w++) {
+        futures << QtConcurrent::run(&_pool, [ = ]() {
+            FrameGrabber grabber;
+            grabber.setCancelFlag(&_cancel);
+            if (!grabber.open(_file)) {
+                qWarning() << "burst: can not open" << _file;
+                if (!_cancel.fetchAndStoreOrdered(1))
+                    emit frameReady(QImage(), 0);
+                return;
+            }
+
+            for (int i = w; i < _points.size() && !_cancel.load(); i += workers) {
+                // grab() seeks to the keyframe before and decodes up to the
+                // point itself, snapping would give several points one frame
+                auto ms = _points[i] * 1000;
+                auto img = grabber.grab(ms);
+                if (img.isNull()) {
+                    qWarning() << "burst: no frame at" << ms;
+                    // report once, the others stop with it
+                    if (!_cancel.fetchAndStoreOrdered(1))
+                        emit frameReady(QImage(), 0);
+                    return;
+                }
+
+                // the stream's own rotation is applied by the grabber,
+                // _rotation is what the user added on top in the player
+                if (_rotation) {
+                    img = img.transformed(QTransform().rotate(_rotation));
+                }
+                emit frameReady(img, ms / 1000);
+            }
+        });
+    }
+
+    for (auto &f : futures) {
+        f.waitForFinished();
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_BURST_EXTRACTOR_H
+#define _DMR_BURST_EXTRACTOR_H
+
+#include <QtGui>
+#include <QtConcurrent>
+
+namespace dmr {
+
+/*
+   class BurstExtractor
+   grabs the frames of a burst screenshot from its own decoders instead of
+   seeking the player. points are spread over a few workers, each with a
+   FrameGrabber over the same file, and every frame is decoded up to its
+   exact point. frames arrive in completion order.
+*/
+class BurstExtractor: public QThread
+{
+    Q_OBJECT
+public:
+    // points in secs, rotation in degrees clockwise applied to every frame
+    // on top of the rotation the stream carries
+    BurstExtractor(const QString &file, const QList<qint64> &points,
+                   int rotation, QObject *parent = nullptr);
+    ~BurstExtractor();
+
+    void cancel();
+
+signals:
+    // emitted from worker threads, a null frame means the burst failed
+    void frameReady(const QImage &frame, qint64 secs);
+
+protected:
+    void run() override;
+
+private:
+    QString _file;
+    QList<qint64> _points;
+    int _rotation {0};
+    QThreadPool _pool;
+    QAtomicInt _cancel {0};
+};
+
+}
+
+#endif /* ifndef _DMR_BURST_EXTRACTOR_H */
@@ -0,0 +1,225 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "dir_scanner.h"
+
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace dmr {
+
+// a batch goes out once it has this many urls or is this old (ms)
+static const int kBatchSize = 512;
+static const int kBatchInterval = 200;
+
+struct DirScanner::Job {
+    int id {0};
+    QSet<QByteArray> suffixes;
+    QAtomicInt cancelled {0};
+    // directories queued or being read, the scan ends when it drops to 0
+    QAtomicInt pending {0};
+
+    QMutex lock;
+    QList<QUrl> batch;
+    QElapsedTimer sinceFlush;
+    bool first {true};
+    int total {0};
+};
+
+static bool matchSuffix(const QSet<QByteArray> &suffixes, const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (!dot || !dot[1]) return false;
+    return suffixes.contains(QByteArray(dot + 1).toLower());
+}
+
+DirScanner::DirScanner(QObject *parent)
+    : QObject(parent)
+{
+    // directory reads mostly wait on the disk or the network
+    _pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount(), 8));
+}
+
+DirScanner::~DirScanner()
+{
+    cancelAll();
+    _pool.waitForDone();
+}
+
+int DirScanner::scan(const QString &root, const QSet<QByteArray> &suffixes)
+{
+    QSharedPointer<Job> job(new Job);
+    job->suffixes = suffixes;
+    job->sinceFlush.start();
+    {
+        QMutexLocker lock(&_lock);
+        job->id = _nextId++;
+        _jobs.insert(job->id, job);
+    }
+
+    enqueue(job, QFile::encodeName(QDir(root).absolutePath()));
+    return job->id;
+}
+
+void DirScanner::cancel(int id)
+{
+    QMutexLocker lock(&_lock);
+    if (auto job = _jobs.value(id)) {
+        job->cancelled.store(1);
+    }
+}
+
+void DirScanner::cancelAll()
+{
+    QMutexLocker lock(&_lock);
+    for (const auto &job : _jobs) {
+        job->cancelled.store(1);
+    }
+}
+
+void DirScanner::waitForDone()
+{
+    _pool.waitForDone();
+}
+
+void DirScanner::enqueue(const QSharedPointer<Job> &job, const QByteArray &dir)
+{
+    job->pending.ref();
+    QtConcurrent::run(&_pool, [ = ]() {
+        walk(job, dir);
+    });
+}
+
+void DirScanner::walk(const QSharedPointer<Job> &job, const QByteArray &dir)
+{
+    QList<QUrl> hits;
+    QElapsedTimer sinceHandOver;
+    sinceHandOver.start();
+    DIR *d = job->cancelled.load() ? nullptr : opendir(dir.constData());
+    if (d) {
+        const QByteArray prefix = dir.endsWith('/') ? dir : dir + '/';
+        while (struct dirent *e = readdir(d)) {
+            if (job->cancelled.load()) break;
+
+            // hidden entries, . and .. are skipped like QDir's default filter does
+            const char *name = e->d_name;
+            if (name[0] == '.') continue;
+
+            QByteArray path = prefix + name;
+            unsigned char type = e->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (lstat(path.constData(), &st) != 0) continue;
+                if (S_ISDIR(st.st_mode)) type = DT_DIR;
+                else if (S_ISREG(st.st_mode)) type = DT_REG;
+                else if (S_ISLNK(st.st_mode)) type = DT_LNK;
+            }
+
+            // symlinked directories are not followed
+            if (type == DT_DIR) {
+                enqueue(job, path);
+                continue;
+            }
+
+            if ((type != DT_REG && type != DT_LNK) || !matchSuffix(job->suffixes, name))
+                continue;
+
+            if (type == DT_LNK) {
+                // a link counts if it leads to a regular file, as QFileInfo::isFile() has it
+                struct stat st;
+                if (stat(path.constData(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+            }
+
+            hits.append(QUrl::fromLocalFile(QFile::decodeName(path)));
+
+            // a flat directory can take long to list, stream what it has
+            // so far: its first hit, then full or aged batches
+            if (hits.size() == 1 || hits.size() >= kBatchSize
+                    || sinceHandOver.elapsed() >= kBatchInterval) {
+                handOver(job.data(), hits);
+                sinceHandOver.restart();
+                flush(job.data(), false);
+            }
+        }
+        closedir(d);
+    } else if (!job->cancelled.load()) {
+        qDebug() << "scanner: can not open" << dir << strerror(errno);
+    }
+
+    handOver(job.data(), hits);
+
+    // flushed before letting go of the directory, so that no batch can
+    // be emitted after finished()
+    flush(job.data(), false);
+    if (job->pending.deref()) return;
+
+    // that was the last directory of the scan
+    flush(job.data(), true);
+    {
+        QMutexLocker lock(&_lock);
+        _jobs.remove(job->id);
+    }
+    emit finished(job->id, job->total, job->cancelled.load());
+}
+
+void DirScanner::handOver(Job *job, QList<QUrl> &hits)
+{
+    if (hits.isEmpty()) return;
+
+    QMutexLocker lock(&job->lock);
+    job->batch += hits;
+    job->total += hits.size();
+    hits.clear();
+}
+
+void DirScanner::flush(Job *job, bool force)
+{
+    QList<QUrl> urls;
+    {
+        QMutexLocker lock(&job->lock);
+        if (job->batch.isEmpty()) return;
+
+        // the first hit goes out at once, so playback can start on it
+        if (!force && !job->first && job->batch.size() < kBatchSize
+                && job->sinceFlush.elapsed() < kBatchInterval)
+            return;
+
+        urls.swap(job->batch);
+        job->first = false;
+        job->sinceFlush.restart();
+    }
+
+    if (!job->cancelled.load()) {
+        emit found(job->id, urls);
+    }
+}
+
+}
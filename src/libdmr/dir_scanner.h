@@ -0,0 +1,82 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_DIR_SCANNER_H
+#define _DMR_DIR_SCANNER_H
+
+#include <QtCore>
+#include <QtConcurrent>
+
+namespace dmr {
+
+/*
+   class DirScanner
+   walks directory trees for playable files on a small thread pool, one
+   task per directory. entries are read with readdir() and told apart by
+   d_type, files are filtered by suffix before anything else, so only
+   symlinks and filesystems without d_type cost a stat(). hits are
+   streamed out in batches while the walk goes on, the first one at once.
+*/
+class DirScanner: public QObject
+{
+    Q_OBJECT
+public:
+    DirScanner(QObject *parent = nullptr);
+    ~DirScanner();
+
+    // suffixes in lower case without the dot, returns the scan id
+    int scan(const QString &root, const QSet<QByteArray> &suffixes);
+    void cancel(int id);
+    void cancelAll();
+    // blocks until every scan started has ended
+    void waitForDone();
+
+signals:
+    // both emitted from pool threads
+    void found(int id, const QList<QUrl> &urls);
+    void finished(int id, int total, bool cancelled);
+
+private:
+    struct Job;
+
+    QThreadPool _pool;
+    QMutex _lock;
+    QHash<int, QSharedPointer<Job>> _jobs;
+    int _nextId {1};
+
+    void enqueue(const QSharedPointer<Job> &job, const QByteArray &dir);
+    void walk(const QSharedPointer<Job> &job, const QByteArray &dir);
+    // moves hits of one directory into the batch of the scan
+    void handOver(Job *job, QList<QUrl> &hits);
+    void flush(Job *job, bool force);
+};
+
+}
+
+#endif /* ifndef _DMR_DIR_SCANNER_H */
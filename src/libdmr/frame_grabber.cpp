@@ -0,0 +1,341 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "frame_grabber.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/display.h>
+#include <libswscale/swscale.h>
+}
+
+#include <QTransform>
+
+#include <algorithm>
+#include <cmath>
+
+// safety net for broken or index-less files, a gop is far shorter
+#define MAX_DECODE_PACKETS 600
+
+namespace dmr {
+
+static AVPixelFormat pixelFormatOf(QImage::Format format)
+{
+    switch (format) {
+    // native endian 0xAARRGGBB, same as QImage
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        return AV_PIX_FMT_RGB32;
+    case QImage::Format_RGB888:
+        return AV_PIX_FMT_RGB24;
+    case QImage::Format_Grayscale8:
+        return AV_PIX_FMT_GRAY8;
+    default:
+        return AV_PIX_FMT_NONE;
+    }
+}
+
+FrameGrabber::FrameGrabber()
+{
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
+}
+
+FrameGrabber::~FrameGrabber()
+{
+    close();
+}
+
+bool FrameGrabber::open(const QString &file)
+{
+    close();
+
+    _fmt = avformat_alloc_context();
+    _fmt->interrupt_callback.callback = &FrameGrabber::interruptCallback;
+    _fmt->interrupt_callback.opaque = this;
+    // frees _fmt on failure
+    if (avformat_open_input(&_fmt, file.toUtf8().constData(), NULL, NULL) < 0) {
+        qWarning() << "avformat: could not open input" << file;
+        _fmt = nullptr;
+        return false;
+    }
+
+    if (avformat_find_stream_info(_fmt, NULL) < 0) {
+        qWarning() << "av_find_stream_info failed" << file;
+        close();
+        return false;
+    }
+
+    _stream = av_find_best_stream(_fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (_stream < 0 || _fmt->streams[_stream]->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+        close();
+        return false;
+    }
+
+    auto *st = _fmt->streams[_stream];
+#if LIBAVFORMAT_VERSION_MAJOR >= 57 && LIBAVFORMAT_VERSION_MINOR <= 25
+    auto codec_id = st->codec->codec_id;
+#else
+    auto codec_id = st->codecpar->codec_id;
+#endif
+    auto *codec = avcodec_find_decoder(codec_id);
+    if (!codec) {
+        qWarning() << "no decoder for" << file;
+        close();
+        return false;
+    }
+
+    _dec = avcodec_alloc_context3(codec);
+#if LIBAVFORMAT_VERSION_MAJOR >= 57 && LIBAVFORMAT_VERSION_MINOR <= 25
+    avcodec_copy_context(_dec, st->codec);
+#else
+    avcodec_parameters_to_context(_dec, st->codecpar);
+#endif
+    // frame threading would delay every grab by thread_count frames
+    _dec->thread_type = FF_THREAD_SLICE;
+    if (avcodec_open2(_dec, codec, NULL) < 0) {
+        qWarning() << "could not open decoder for" << file;
+        close();
+        return false;
+    }
+
+    _frame = av_frame_alloc();
+    _file = file;
+    _startPts = st->start_time == AV_NOPTS_VALUE ? 0 : st->start_time;
+
+    if (st->duration != AV_NOPTS_VALUE) {
+        _duration = toMsecs(st->duration + _startPts);
+    } else if (_fmt->duration != AV_NOPTS_VALUE) {
+        _duration = _fmt->duration / (AV_TIME_BASE / 1000);
+    }
+
+    QSize sz(_dec->width, _dec->height);
+    auto sar = av_guess_sample_aspect_ratio(_fmt, st, NULL);
+    if (sar.num > 0 && sar.den > 0) {
+        sz.setWidth(sz.width() * sar.num / sar.den);
+    }
+    // portrait phone videos are stored landscape with a rotation attached
+    _rotation = streamRotation();
+    _frameSize = _rotation % 180 ? sz.transposed() : sz;
+
+    buildIndex();
+    return true;
+}
+
+void FrameGrabber::close()
+{
+    if (_sws) {
+        sws_freeContext(_sws);
+        _sws = nullptr;
+    }
+    if (_frame) {
+        av_frame_free(&_frame);
+    }
+    if (_dec) {
+        avcodec_free_context(&_dec);
+    }
+    if (_fmt) {
+        avformat_close_input(&_fmt);
+    }
+
+    _stream = -1;
+    _startPts = 0;
+    _duration = 0;
+    _frameSize = QSize();
+    _rotation = 0;
+    _keyframes.clear();
+    _file.clear();
+}
+
+int FrameGrabber::interruptCallback(void *opaque)
+{
+    return static_cast<FrameGrabber *>(opaque)->cancelled() ? 1 : 0;
+}
+
+void FrameGrabber::buildIndex()
+{
+    auto *st = _fmt->streams[_stream];
+
+    // some demuxers (matroska) defer reading the index until the first seek
+    av_seek_frame(_fmt, _stream, _startPts, AVSEEK_FLAG_BACKWARD);
+
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    int n = avformat_index_get_entries_count(st);
+#else
+    int n = st->nb_index_entries;
+#endif
+    _keyframes.reserve(n);
+    for (int i = 0; i < n; i++) {
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+        const auto *e = avformat_index_get_entry(st, i);
+#else
+        const auto *e = &st->index_entries[i];
+#endif
+        if (e->flags & AVINDEX_KEYFRAME) {
+            _keyframes.append(toMsecs(e->timestamp));
+        }
+    }
+
+    std::sort(_keyframes.begin(), _keyframes.end());
+    _keyframes.erase(std::unique(_keyframes.begin(), _keyframes.end()), _keyframes.end());
+    qDebug() << _file << "keyframes" << _keyframes.size();
+}
+
+int FrameGrabber::streamRotation() const
+{
+    auto *st = _fmt->streams[_stream];
+    double theta = 0;
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 29, 100)
+    const auto *sd = av_packet_side_data_get(st->codecpar->coded_side_data,
+                                             st->codecpar->nb_coded_side_data,
+                                             AV_PKT_DATA_DISPLAYMATRIX);
+    const uint8_t *matrix = sd ? sd->data : nullptr;
+#else
+    const uint8_t *matrix = av_stream_get_side_data(st, AV_PKT_DATA_DISPLAYMATRIX, NULL);
+#endif
+    if (matrix) {
+        // the matrix holds the counter-clockwise angle
+        theta = -av_display_rotation_get((const int32_t *)matrix);
+    } else if (auto *tag = av_dict_get(st->metadata, "rotate", NULL, 0)) {
+        theta = QString(tag->value).toDouble();
+    }
+
+    if (std::isnan(theta)) return 0;
+
+    // snapped to quarter turns, same as mpv and ffmpeg do
+    int deg = int(std::round(theta / 90)) * 90;
+    return ((deg % 360) + 360) % 360;
+}
+
+qint64 FrameGrabber::toMsecs(qint64 pts) const
+{
+    return av_rescale_q(pts - _startPts, _fmt->streams[_stream]->time_base, AVRational{1, 1000});
+}
+
+qint64 FrameGrabber::toPts(qint64 ms) const
+{
+    return av_rescale_q(ms, AVRational{1, 1000}, _fmt->streams[_stream]->time_base) + _startPts;
+}
+
+qint64 FrameGrabber::nearestKeyframe(qint64 ms) const
+{
+    if (_keyframes.isEmpty()) return ms;
+
+    auto p = std::lower_bound(_keyframes.cbegin(), _keyframes.cend(), ms);
+    if (p == _keyframes.cend()) return _keyframes.last();
+    if (p == _keyframes.cbegin()) return *p;
+
+    auto prev = p - 1;
+    return (ms - *prev) <= (*p - ms) ? *prev : *p;
+}
+
+QImage FrameGrabber::grab(qint64 ms, const QSize &size, Qt::AspectRatioMode mode,
+                          QImage::Format format)
+{
+    if (!_fmt) return QImage();
+
+    if (pixelFormatOf(format) == AV_PIX_FMT_NONE) {
+        qWarning() << "unsupported image format" << format;
+        return QImage();
+    }
+
+    if (_duration > 0) {
+        ms = qBound(0LL, ms, _duration);
+    }
+
+    if (av_seek_frame(_fmt, _stream, toPts(ms), AVSEEK_FLAG_BACKWARD) < 0) {
+        qWarning() << "seek failed" << _file << ms;
+    }
+    avcodec_flush_buffers(_dec);
+
+    AVPacket *pkt = av_packet_alloc();
+    bool got = false;
+    bool eof = false;
+    for (int n = 0; !got && !eof && n < MAX_DECODE_PACKETS && !cancelled(); ) {
+        if (av_read_frame(_fmt, pkt) < 0) {
+            eof = true;
+            avcodec_send_packet(_dec, NULL);
+        } else {
+            if (pkt->stream_index != _stream) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            n++;
+            avcodec_send_packet(_dec, pkt);
+            av_packet_unref(pkt);
+        }
+
+        while (avcodec_receive_frame(_dec, _frame) == 0) {
+            auto pts = _frame->best_effort_timestamp;
+            if (pts == AV_NOPTS_VALUE || toMsecs(pts) >= ms) {
+                got = true;
+                break;
+            }
+        }
+    }
+    av_packet_free(&pkt);
+
+    if (!got) {
+        if (!cancelled()) qWarning() << "no frame decoded" << _file << ms;
+        return QImage();
+    }
+
+    return convert(size.isEmpty() ? _frameSize : _frameSize.scaled(size, mode), format);
+}
+
+QImage FrameGrabber::convert(const QSize &size, QImage::Format format)
+{
+    if (size.isEmpty()) return QImage();
+
+    // size is what gets displayed, the decoded frame is still unrotated
+    QSize scaled = _rotation % 180 ? size.transposed() : size;
+    _sws = sws_getCachedContext(_sws, _frame->width, _frame->height,
+                                (AVPixelFormat)_frame->format,
+                                scaled.width(), scaled.height(), pixelFormatOf(format),
+                                SWS_BILINEAR, NULL, NULL, NULL);
+    if (!_sws) return QImage();
+
+    QImage img(scaled, format);
+    uint8_t *dst[4] = {img.bits(), NULL, NULL, NULL};
+    int stride[4] = {img.bytesPerLine(), 0, 0, 0};
+    sws_scale(_sws, _frame->data, _frame->linesize, 0, _frame->height, dst, stride);
+    av_frame_unref(_frame);
+
+    if (_rotation) {
+        // quarter turns, QImage transposes the pixels without resampling
+        img = img.transformed(QTransform().rotate(_rotation));
+    }
+    return img;
+}
+
+}
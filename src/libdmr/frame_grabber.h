@@ -0,0 +1,113 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_FRAME_GRABBER_H
+#define _DMR_FRAME_GRABBER_H
+
+#include <QtCore>
+#include <QImage>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct SwsContext;
+
+namespace dmr {
+
+/*
+   class FrameGrabber
+   decodes still frames out of one local file. the demuxer and decoder stay
+   open between grabs, and the keyframe index of the container is read once
+   when the file is opened, so a grab near a keyframe costs one seek and a
+   single gop decode. frames are converted straight into a QImage.
+   not thread-safe: use one grabber per thread.
+*/
+class FrameGrabber
+{
+public:
+    FrameGrabber();
+    ~FrameGrabber();
+
+    // demuxing and decoding give up as soon as *flag becomes non-zero,
+    // set it before open()
+    void setCancelFlag(const QAtomicInt *flag) { _cancel = flag; }
+
+    bool open(const QString &file);
+    void close();
+    bool isOpen() const { return _fmt != nullptr; }
+    QString file() const { return _file; }
+
+    // in msecs
+    qint64 duration() const { return _duration; }
+    // displayed size, sample aspect ratio and rotation applied
+    QSize frameSize() const { return _frameSize; }
+    // clockwise degrees the stream asks to be displayed at (0, 90, 180, 270),
+    // grabbed images come out already rotated
+    int rotation() const { return _rotation; }
+
+    // msecs of every keyframe found in the container index, ascending.
+    // empty when the container carries no index (e.g mpeg-ts)
+    const QVector<qint64> &keyframes() const { return _keyframes; }
+    // ms itself if there is no index
+    qint64 nearestKeyframe(qint64 ms) const;
+
+    // first frame at or after ms, scaled to frameSize().scaled(size, mode).
+    // an empty size keeps frameSize(). swscale writes straight into the
+    // returned image, format is one of RGB32, ARGB32, RGB888, Grayscale8
+    QImage grab(qint64 ms, const QSize &size = QSize(),
+                Qt::AspectRatioMode mode = Qt::KeepAspectRatio,
+                QImage::Format format = QImage::Format_RGB32);
+
+private:
+    QString _file;
+    AVFormatContext *_fmt {nullptr};
+    AVCodecContext *_dec {nullptr};
+    AVFrame *_frame {nullptr};
+    SwsContext *_sws {nullptr};
+    int _stream {-1};
+    qint64 _startPts {0};
+    qint64 _duration {0};
+    QSize _frameSize;
+    int _rotation {0};
+    QVector<qint64> _keyframes;
+    const QAtomicInt *_cancel {nullptr};
+
+    static int interruptCallback(void *opaque);
+    bool cancelled() const { return _cancel && _cancel->load(); }
+    void buildIndex();
+    int streamRotation() const;
+    qint64 toMsecs(qint64 pts) const;
+    qint64 toPts(qint64 ms) const;
+    QImage convert(const QSize &size, QImage::Format format);
+};
+
+}
+
+#endif /* ifndef _DMR_FRAME_GRABBER_H */
+
@@ -0,0 +1,208 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "movie_prober.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+#include <libavutil/avutil.h>
+}
+
+#include <atomic>
+
+// enough to find both streams of common containers while avoiding a
+// full decode of the first seconds like avformat_find_stream_info does
+// by default
+#define DEFAULT_PROBE_SIZE (1 << 20)
+#define DEFAULT_ANALYZE_DURATION (2 * AV_TIME_BASE)
+
+namespace dmr {
+static std::atomic<MovieProber *> _instance { nullptr };
+static QMutex _instLock;
+
+struct StreamParams {
+    int codec_id {0};
+    qint64 bit_rate {0};
+    int width {0};
+    int height {0};
+    int format {0};
+    int channels {0};
+    int sample_rate {0};
+};
+
+static StreamParams stream_params(AVStream *st)
+{
+    StreamParams sp;
+#if LIBAVFORMAT_VERSION_MAJOR >= 57 && LIBAVFORMAT_VERSION_MINOR <= 25
+    auto *par = st->codec;
+    sp.format = par->codec_type == AVMEDIA_TYPE_AUDIO ? par->sample_fmt : par->pix_fmt;
+#else
+    auto *par = st->codecpar;
+    sp.format = par->format;
+#endif
+    sp.codec_id = par->codec_id;
+    sp.bit_rate = par->bit_rate;
+    sp.width = par->width;
+    sp.height = par->height;
+    sp.channels = par->channels;
+    sp.sample_rate = par->sample_rate;
+    return sp;
+}
+
+MovieProber &MovieProber::get()
+{
+    if (_instance == nullptr) {
+        QMutexLocker lock(&_instLock);
+        if (_instance == nullptr) {
+            _instance = new MovieProber;
+        }
+    }
+
+    return *_instance;
+}
+
+MovieProber::MovieProber()
+    : QObject(0),
+      _probeSize(DEFAULT_PROBE_SIZE),
+      _analyzeDuration(DEFAULT_ANALYZE_DURATION)
+{
+    av_register_all();
+    setMaxConcurrency(0);
+}
+
+void MovieProber::setMaxConcurrency(int n)
+{
+    if (n <= 0) {
+        n = QThread::idealThreadCount();
+    }
+    _pool.setMaxThreadCount(qMax(n, 1));
+    qDebug() << "probe concurrency" << _pool.maxThreadCount();
+}
+
+int MovieProber::maxConcurrency() const
+{
+    return _pool.maxThreadCount();
+}
+
+void MovieProber::setProbeBudget(qint64 probeSize, qint64 analyzeDuration)
+{
+    if (probeSize > 0) _probeSize.store(probeSize);
+    if (analyzeDuration > 0) _analyzeDuration.store(analyzeDuration);
+}
+
+struct MovieInfo MovieProber::probe(const QFileInfo &fi, bool *ok) const
+{
+    struct MovieInfo mi {};
+    mi.valid = false;
+
+    if (ok) *ok = false;
+    if (!fi.exists()) {
+        return mi;
+    }
+
+    AVFormatContext *av_ctx = NULL;
+    AVDictionary *opts = NULL;
+    av_dict_set(&opts, "probesize", QByteArray::number(_probeSize.load()).constData(), 0);
+    av_dict_set(&opts, "analyzeduration",
+                QByteArray::number(_analyzeDuration.load()).constData(), 0);
+
+    auto ret = avformat_open_input(&av_ctx, fi.filePath().toUtf8().constData(), NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        qWarning() << "avformat: could not open input" << fi.fileName();
+        return mi;
+    }
+
+    if (avformat_find_stream_info(av_ctx, NULL) < 0 || av_ctx->nb_streams == 0) {
+        qWarning() << "av_find_stream_info failed" << fi.fileName();
+        avformat_close_input(&av_ctx);
+        return mi;
+    }
+
+    // one selection pass for both kinds, related audio preferred
+    int vidx = av_find_best_stream(av_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    int aidx = av_find_best_stream(av_ctx, AVMEDIA_TYPE_AUDIO, -1, vidx, NULL, 0);
+    if (vidx < 0 && aidx < 0) {
+        avformat_close_input(&av_ctx);
+        return mi;
+    }
+
+    // keep the old behavior: a missing kind is described by the other one
+    AVStream *vst = av_ctx->streams[vidx >= 0 ? vidx : aidx];
+    AVStream *ast = av_ctx->streams[aidx >= 0 ? aidx : vidx];
+    auto vp = stream_params(vst);
+    auto ap = stream_params(ast);
+
+    mi.width = vp.width;
+    mi.height = vp.height;
+    auto duration = av_ctx->duration == AV_NOPTS_VALUE ? 0 : av_ctx->duration;
+    duration = duration + (duration <= INT64_MAX - 5000 ? 5000 : 0);
+    mi.duration = duration / AV_TIME_BASE;
+    mi.title = fi.fileName(); //FIXME this
+    mi.filePath = fi.canonicalFilePath();
+    mi.creation = fi.created().toString();
+    mi.fileSize = fi.size();
+    mi.fileType = fi.suffix();
+
+    mi.vCodecID = vp.codec_id;
+    mi.vCodeRate = vp.bit_rate;
+    auto fr = vst->avg_frame_rate.den ? vst->avg_frame_rate : vst->r_frame_rate;
+    mi.fps = fr.den != 0 ? fr.num / fr.den : 0;
+    mi.proportion = mi.height != 0 ? mi.width / mi.height : 0;
+
+    mi.aCodeID = ap.codec_id;
+    mi.aCodeRate = ap.bit_rate;
+    mi.aDigit = ap.format;
+    mi.channels = ap.channels;
+    mi.sampling = ap.sample_rate;
+
+    auto *tag = av_dict_get(av_ctx->metadata, "creation_time", NULL, 0);
+    if (tag) {
+        mi.creation = QDateTime::fromString(tag->value, Qt::ISODate).toString();
+    }
+
+    tag = av_dict_get(vst->metadata, "rotate", NULL, 0);
+    if (tag) {
+        mi.raw_rotate = QString(tag->value).toInt();
+        auto vr = (mi.raw_rotate + 360) % 360;
+        if (vr == 90 || vr == 270) {
+            std::swap(mi.width, mi.height);
+        }
+    }
+    mi.resolution = QString("%1x%2").arg(mi.width).arg(mi.height);
+
+    avformat_close_input(&av_ctx);
+    mi.valid = true;
+
+    if (ok) *ok = true;
+    return mi;
+}
+
+}
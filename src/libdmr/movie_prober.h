@@ -0,0 +1,119 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_MOVIE_PROBER_H
+#define _DMR_MOVIE_PROBER_H
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QFutureInterface>
+
+#include "playlist_model.h"
+
+namespace dmr {
+
+/*
+   class MovieProber
+   extracts MovieInfo from local media files. every file is opened once
+   with a bounded probe budget (probesize/analyzeduration) and both video
+   and audio streams are selected in a single pass. probing runs on a
+   dedicated thread pool so big imports scale with cores and never block
+   the gui thread.
+*/
+class MovieProber: public QObject
+{
+    Q_OBJECT
+public:
+    static MovieProber &get();
+
+    // 0 means QThread::idealThreadCount()
+    void setMaxConcurrency(int n);
+    int maxConcurrency() const;
+
+    // bytes read / microseconds analyzed by avformat_find_stream_info
+    void setProbeBudget(qint64 probeSize, qint64 analyzeDuration);
+    qint64 probeSize() const { return _probeSize.load(); }
+    qint64 analyzeDuration() const { return _analyzeDuration.load(); }
+
+    // synchronous, thread-safe
+    struct MovieInfo probe(const QFileInfo &fi, bool *ok = nullptr) const;
+
+    QThreadPool *pool() { return &_pool; }
+
+    // apply fn to every element of jobs on the probe pool, results keep
+    // the order of jobs. this is what QtConcurrent::mapped does, except
+    // that it respects our own concurrency cap.
+    template <typename T, typename Job, typename Functor>
+    QFuture<T> mapped(const QList<Job> &jobs, Functor fn);
+
+private:
+    MovieProber();
+
+    QThreadPool _pool;
+    QAtomicInteger<qint64> _probeSize;
+    QAtomicInteger<qint64> _analyzeDuration;
+};
+
+template <typename T, typename Job, typename Functor>
+QFuture<T> MovieProber::mapped(const QList<Job> &jobs, Functor fn)
+{
+    struct State {
+        QFutureInterface<T> fi;
+        QAtomicInt remains;
+    };
+
+    auto st = QSharedPointer<State>::create();
+    st->fi.reportStarted();
+    st->remains.store(jobs.size());
+    auto future = st->fi.future();
+
+    if (jobs.isEmpty()) {
+        st->fi.reportFinished();
+        return future;
+    }
+
+    for (int i = 0; i < jobs.size(); i++) {
+        auto job = jobs[i];
+        QtConcurrent::run(&_pool, [ = ]() mutable {
+            if (!st->fi.isCanceled()) {
+                T res = fn(job);
+                st->fi.reportResult(res, i);
+            }
+            if (!st->remains.deref()) {
+                st->fi.reportFinished();
+            }
+        });
+    }
+
+    return future;
+}
+
+}
+
+#endif /* ifndef _DMR_MOVIE_PROBER_H */
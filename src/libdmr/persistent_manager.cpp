@@ -0,0 +1,596 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "persistent_manager.h"
+#include "utils.h"
+#ifndef _LIBDMR_
+#include "dmr_settings.h"
+#endif
+
+#include <atomic>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC 0x434d4d44 // "DMMC"
+// bump when the layout of MovieInfo or of the record header changes, or
+// when cached images would come out differently (3: stream rotation),
+// records of other versions are ignored and dropped by compaction
+#define CACHE_VERSION 3
+#define CACHE_SIZE_BUDGET (256 * (1 << 20))
+#define CACHE_MAX_AGE_DAYS 90
+// the file is grown (and remapped) ahead of the records in steps of this
+#define CACHE_GROW_CHUNK (4 * (1 << 20))
+
+namespace dmr {
+static std::atomic<PersistentManager *> _instance { nullptr };
+static QMutex _instLock;
+
+struct RecordHeader {
+    quint32 magic;
+    quint8 version;
+    quint8 kind;
+    quint16 reserved;
+    quint32 size;  // payload size in bytes, payload follows the header
+    quint32 reserved2;
+    qint64 stamp;  // secs since epoch when written
+    char key[32];  // sha256 of url, see hashUrl/hashStrip
+};
+static_assert(sizeof(RecordHeader) == 56, "cache record header must be packed");
+
+// identity of the cached file, every payload starts with it. a cheap
+// stat() on lookup tells whether the file was replaced in place.
+struct FileStamp {
+    qint64 mtime;  // msecs
+    qint64 size;
+    quint64 inode;
+    char hash[16]; // FastFileHash, zeroed unless content hashing is on
+};
+
+static bool statFile(const QUrl &url, FileStamp *fs)
+{
+    if (!url.isLocalFile()) return false;
+
+    struct stat st;
+    if (::stat(QFile::encodeName(url.toLocalFile()).constData(), &st) != 0) {
+        return false;
+    }
+
+    memset(fs, 0, sizeof *fs);
+    fs->mtime = (qint64)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000;
+    fs->size = st.st_size;
+    fs->inode = st.st_ino;
+    return true;
+}
+
+static void hashFile(const QUrl &url, FileStamp *fs)
+{
+    auto h = QByteArray::fromHex(utils::FastFileHash(QFileInfo(url.toLocalFile())).toLatin1());
+    memcpy(fs->hash, h.constData(), qMin(h.size(), (int)sizeof fs->hash));
+}
+
+static QByteArray hashUrl(const QUrl &url)
+{
+    return QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha256);
+}
+
+// strips get entries of their own, one per slice count
+static QByteArray hashStrip(const QUrl &url, int count)
+{
+    return QCryptographicHash::hash(url.toEncoded() + "#strip" + QByteArray::number(count),
+                                    QCryptographicHash::Sha256);
+}
+
+static qint64 now()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
+
+static qint64 recordSize(quint32 payload)
+{
+    return payload ? (qint64)sizeof(RecordHeader) + payload : 0;
+}
+
+static bool writeRecord(QIODevice *dev, int kind, const QByteArray &key, qint64 stamp,
+                        const char *data, quint32 size)
+{
+    RecordHeader hdr;
+    memset(&hdr, 0, sizeof hdr);
+    hdr.magic = CACHE_MAGIC;
+    hdr.version = CACHE_VERSION;
+    hdr.kind = kind;
+    hdr.size = size;
+    hdr.stamp = stamp;
+    memcpy(hdr.key, key.constData(), qMin(key.size(), (int)sizeof hdr.key));
+
+    return dev->write((const char *)&hdr, sizeof hdr) == sizeof hdr &&
+           dev->write(data, size) == size;
+}
+
+PersistentManager &PersistentManager::get()
+{
+    if (_instance == nullptr) {
+        QMutexLocker lock(&_instLock);
+        if (_instance == nullptr) {
+            _instance = new PersistentManager;
+        }
+    }
+
+    return *_instance;
+}
+
+PersistentManager::PersistentManager()
+    : _maxBytes(CACHE_SIZE_BUDGET), _maxAgeDays(CACHE_MAX_AGE_DAYS)
+{
+    auto tmpl = QString("%1/%2/%3/%4")
+                .arg(QStandardPaths::writableLocation(QStandardPaths::ConfigLocation))
+                .arg(qApp->organizationName())
+                .arg(qApp->applicationName());
+
+    // file-per-url layout used by older versions
+    for (auto name : {"cacheinfo", "thumbs"}) {
+        QDir d(tmpl.arg(name));
+        if (d.exists()) {
+            d.removeRecursively();
+        }
+    }
+
+    _path = tmpl.arg("metacache");
+    QDir().mkpath(QFileInfo(_path).absolutePath());
+
+#ifndef _LIBDMR_
+    // MB and days, 0 keeps the built-in limit
+    auto mb = Settings::get().internalOption("metacache_size").toLongLong();
+    if (mb > 0) _maxBytes = mb << 20;
+    auto days = Settings::get().internalOption("metacache_max_age").toInt();
+    if (days > 0) _maxAgeDays = days;
+#endif
+
+    QWriteLocker lock(&_lock);
+    if (openStore()) {
+        scan();
+        // expired entries are only dropped by compaction, a cache that
+        // stays well in budget would otherwise keep them forever
+        if (_end > _maxBytes || _end - _liveBytes > qMax(_liveBytes, (qint64)(1 << 20))
+                || hasExpired()) {
+            doCompact();
+        }
+    }
+}
+
+PersistentManager::~PersistentManager()
+{
+    QWriteLocker lock(&_lock);
+    if (_map) _file.unmap(_map);
+    // the room grown ahead of the last record
+    if (_file.isOpen() && _file.size() > _end) _file.resize(_end);
+    _file.close();
+}
+
+bool PersistentManager::openStore()
+{
+    if (_map) {
+        _file.unmap(_map);
+        _map = nullptr;
+        _mapSize = 0;
+    }
+    _file.close();
+
+    _file.setFileName(_path);
+    if (!_file.open(QIODevice::ReadWrite)) {
+        qWarning() << _file.errorString();
+        return false;
+    }
+
+    _end = _file.size();
+    return remap();
+}
+
+bool PersistentManager::remap()
+{
+    if (_map) {
+        _file.unmap(_map);
+        _map = nullptr;
+        _mapSize = 0;
+    }
+
+    auto sz = _file.size();
+    if (sz == 0) return true;
+
+    _map = _file.map(0, sz);
+    if (!_map) {
+        qWarning() << "map cache failed" << _file.errorString();
+        return false;
+    }
+    _mapSize = sz;
+    return true;
+}
+
+void PersistentManager::scan()
+{
+    _index.clear();
+
+    qint64 pos = 0;
+    while (pos + (qint64)sizeof(RecordHeader) <= _mapSize) {
+        RecordHeader hdr;
+        memcpy(&hdr, _map + pos, sizeof hdr);
+        auto off = pos + (qint64)sizeof hdr;
+        if (hdr.magic != CACHE_MAGIC || off + hdr.size > _mapSize) {
+            break;
+        }
+
+        if (hdr.version == CACHE_VERSION && hdr.size >= sizeof(FileStamp)) {
+            auto &e = _index[QByteArray(hdr.key, sizeof hdr.key)];
+            if (hdr.kind == RecordKind::Info) {
+                e.infoOffset = off;
+                e.infoSize = hdr.size;
+            } else if (hdr.kind == RecordKind::Thumb) {
+                e.thumbOffset = off;
+                e.thumbSize = hdr.size;
+            } else if (hdr.kind == RecordKind::Strip) {
+                e.stripOffset = off;
+                e.stripSize = hdr.size;
+            }
+            e.stamp = qMax(e.stamp, hdr.stamp);
+        }
+        pos = off + hdr.size;
+    }
+
+    if (pos < _file.size()) {
+        // torn write or unused room left by a crash, drop the tail
+        qWarning() << "cache truncated at" << pos << "of" << _file.size();
+        if (_map) _file.unmap(_map);
+        _map = nullptr;
+        _file.resize(pos);
+        remap();
+    }
+    _end = pos;
+
+    _liveBytes = 0;
+    for (const auto &e : _index) {
+        _liveBytes += recordSize(e.infoSize) + recordSize(e.thumbSize) + recordSize(e.stripSize);
+    }
+    qDebug() << "metacache" << _index.size() << "entries," << _liveBytes << "of" << _end << "bytes live";
+}
+
+bool PersistentManager::append(RecordKind kind, const QByteArray &key, const QByteArray &payload)
+{
+    if (!_file.isOpen() || payload.isEmpty()) return false;
+
+    auto stamp = now();
+    auto off = _end;
+    auto end = off + recordSize(payload.size());
+
+    // remapping the whole file for every record is what an import of
+    // thousands of files would otherwise pay for, room is made in chunks
+    // and mapped once per chunk
+    if (end > _file.size()) {
+        if (_map) _file.unmap(_map);
+        _map = nullptr;
+        _mapSize = 0;
+        if (!_file.resize(qMax(end, _file.size() + qMax((qint64)CACHE_GROW_CHUNK, _file.size() / 8)))) {
+            qWarning() << _file.errorString();
+            remap();
+            return false;
+        }
+    }
+
+    _file.seek(off);
+    if (!writeRecord(&_file, kind, key, stamp, payload.constData(), payload.size()) || !_file.flush()) {
+        qWarning() << _file.errorString();
+        // a half written header must not be taken for a record
+        if (_map) _file.unmap(_map);
+        _map = nullptr;
+        _mapSize = 0;
+        _file.resize(off);
+        remap();
+        return false;
+    }
+    _end = end;
+
+    auto &e = _index[key];
+    if (kind == RecordKind::Info) {
+        _liveBytes -= recordSize(e.infoSize);
+        e.infoOffset = off + sizeof(RecordHeader);
+        e.infoSize = payload.size();
+    } else if (kind == RecordKind::Thumb) {
+        _liveBytes -= recordSize(e.thumbSize);
+        e.thumbOffset = off + sizeof(RecordHeader);
+        e.thumbSize = payload.size();
+    } else {
+        _liveBytes -= recordSize(e.stripSize);
+        e.stripOffset = off + sizeof(RecordHeader);
+        e.stripSize = payload.size();
+    }
+    _liveBytes += recordSize(payload.size());
+    e.stamp = stamp;
+
+    if (_mapSize < _file.size() && !remap()) return false;
+    if (_end > _maxBytes) {
+        doCompact();
+    }
+    return true;
+}
+
+PersistentManager::CacheInfo PersistentManager::loadFromCache(const QUrl &url)
+{
+    CacheInfo ci;
+
+    FileStamp fs;
+    if (!statFile(url, &fs)) return ci;
+
+    // readers decode straight from the mapping, writers remap under the
+    // write lock only
+    QReadLocker lock(&_lock);
+    auto p = _index.constFind(hashUrl(url));
+    if (p == _index.cend() || p->infoOffset < 0) return ci;
+
+    if (!isFresh(p->infoOffset, url, fs)) {
+        qDebug() << url.fileName() << "changed since cached, drop";
+        return ci;
+    }
+
+    {
+        auto bytes = QByteArray::fromRawData((const char *)_map + p->infoOffset + sizeof(FileStamp),
+                                             p->infoSize - sizeof(FileStamp));
+        QDataStream ds(bytes);
+        ds.setVersion(QDataStream::Qt_5_0);
+        ds >> ci.mi;
+        ci.mi_valid = ds.status() == QDataStream::Ok && ci.mi.valid;
+    }
+
+    if (ci.mi_valid && p->thumbOffset >= 0 && isFresh(p->thumbOffset, url, fs)) {
+        ci.thumb = QImage::fromData(_map + p->thumbOffset + sizeof(FileStamp),
+                                    p->thumbSize - sizeof(FileStamp), "png");
+        ci.thumb.setDevicePixelRatio(qApp->devicePixelRatio());
+        ci.thumb_valid = !ci.thumb.isNull();
+    }
+
+    return ci;
+}
+
+void PersistentManager::save(const PlayItemInfo &pif)
+{
+    FileStamp fs;
+    if (!statFile(pif.url, &fs)) return;
+    if (_hashContent.load()) hashFile(pif.url, &fs);
+
+    QByteArray info((const char *)&fs, sizeof fs);
+    {
+        QDataStream ds(&info, QIODevice::WriteOnly | QIODevice::Append);
+        ds.setVersion(QDataStream::Qt_5_0);
+        ds << pif.mi;
+    }
+
+    QByteArray thumb;
+    if (!pif.thumbnail.isNull()) {
+        thumb.append((const char *)&fs, sizeof fs);
+        QBuffer buf(&thumb);
+        buf.open(QIODevice::WriteOnly | QIODevice::Append);
+        pif.thumbnail.save(&buf, "png");
+    }
+
+    auto key = hashUrl(pif.url);
+    QWriteLocker lock(&_lock);
+    if (append(RecordKind::Info, key, info)) {
+        qDebug() << "cache" << pif.url << "->" << key.toHex();
+        append(RecordKind::Thumb, key, thumb);
+    }
+}
+
+void PersistentManager::saveThumbnail(const QUrl &url, const QByteArray &data)
+{
+    FileStamp fs;
+    if (!statFile(url, &fs)) return;
+    if (_hashContent.load()) hashFile(url, &fs);
+
+    auto key = hashUrl(url);
+    QWriteLocker lock(&_lock);
+    append(RecordKind::Thumb, key, QByteArray((const char *)&fs, sizeof fs) + data);
+}
+
+QImage PersistentManager::loadThumbnail(const QUrl &url)
+{
+    FileStamp fs;
+    if (!statFile(url, &fs)) return QImage();
+
+    QReadLocker lock(&_lock);
+    auto p = _index.constFind(hashUrl(url));
+    if (p == _index.cend() || p->thumbOffset < 0 || !isFresh(p->thumbOffset, url, fs)) {
+        return QImage();
+    }
+
+    return QImage::fromData(_map + p->thumbOffset + sizeof(FileStamp),
+                            p->thumbSize - sizeof(FileStamp), "png");
+}
+
+QImage PersistentManager::loadFilmStrip(const QUrl &url, int count)
+{
+    FileStamp fs;
+    if (!statFile(url, &fs)) return QImage();
+
+    QReadLocker lock(&_lock);
+    auto p = _index.constFind(hashStrip(url, count));
+    if (p == _index.cend() || p->stripOffset < 0 || !isFresh(p->stripOffset, url, fs)) {
+        return QImage();
+    }
+
+    return QImage::fromData(_map + p->stripOffset + sizeof(FileStamp),
+                            p->stripSize - sizeof(FileStamp), "png");
+}
+
+void PersistentManager::saveFilmStrip(const QUrl &url, int count, const QImage &strip)
+{
+    FileStamp fs;
+    if (strip.isNull() || !statFile(url, &fs)) return;
+    if (_hashContent.load()) hashFile(url, &fs);
+
+    QByteArray data((const char *)&fs, sizeof fs);
+    QBuffer buf(&data);
+    buf.open(QIODevice::WriteOnly | QIODevice::Append);
+    strip.save(&buf, "png");
+
+    QWriteLocker lock(&_lock);
+    append(RecordKind::Strip, hashStrip(url, count), data);
+}
+
+void PersistentManager::setContentHashing(bool on)
+{
+    _hashContent.store(on);
+}
+
+bool PersistentManager::isFresh(qint64 offset, const QUrl &url, const FileStamp &st) const
+{
+    FileStamp cached;
+    memcpy(&cached, _map + offset, sizeof cached);
+    if (cached.mtime != st.mtime || cached.size != st.size || cached.inode != st.inode) {
+        return false;
+    }
+
+    if (_hashContent.load()) {
+        FileStamp hashed = st;
+        hashFile(url, &hashed);
+        return memcmp(cached.hash, hashed.hash, sizeof cached.hash) == 0;
+    }
+    return true;
+}
+
+bool PersistentManager::cacheExists(const QUrl &url)
+{
+    QReadLocker lock(&_lock);
+    auto p = _index.constFind(hashUrl(url));
+    return p != _index.cend() && p->infoOffset >= 0;
+}
+
+void PersistentManager::setBudget(qint64 maxBytes, int maxAgeDays)
+{
+    QWriteLocker lock(&_lock);
+    if (maxBytes > 0) _maxBytes = maxBytes;
+    if (maxAgeDays > 0) _maxAgeDays = maxAgeDays;
+    if (_end > _maxBytes || hasExpired()) {
+        doCompact();
+    }
+}
+
+void PersistentManager::compact()
+{
+    QWriteLocker lock(&_lock);
+    doCompact();
+}
+
+qint64 PersistentManager::expireStamp() const
+{
+    return now() - (qint64)_maxAgeDays * 24 * 3600;
+}
+
+bool PersistentManager::hasExpired() const
+{
+    auto expire = expireStamp();
+    for (const auto &e : _index) {
+        if (e.stamp < expire) return true;
+    }
+    return false;
+}
+
+void PersistentManager::doCompact()
+{
+    if (!_file.isOpen()) return;
+
+    // newest first, stop at 3/4 of the budget so that compaction does not
+    // kick in again right away
+    QList<QPair<qint64, QByteArray>> order;
+    auto expire = expireStamp();
+    for (auto p = _index.cbegin(); p != _index.cend(); ++p) {
+        // thumbnail-only entries are kept too, the budget cut decides
+        if (p->stamp >= expire) {
+            order.append(qMakePair(p->stamp, p.key()));
+        }
+    }
+    std::sort(order.begin(), order.end(), [](const QPair<qint64, QByteArray> &a,
+    const QPair<qint64, QByteArray> &b) {
+        return a.first > b.first;
+    });
+
+    QSaveFile out(_path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << out.errorString();
+        return;
+    }
+
+    QHash<QByteArray, Entry> index;
+    qint64 written = 0;
+    auto target = _maxBytes / 4 * 3;
+    for (const auto &o : order) {
+        const auto &e = *_index.constFind(o.second);
+        auto sz = recordSize(e.infoSize) + recordSize(e.thumbSize) + recordSize(e.stripSize);
+        if (written + sz > target) break;
+
+        Entry ne;
+        ne.stamp = e.stamp;
+        if (e.infoOffset >= 0) {
+            ne.infoOffset = written + sizeof(RecordHeader);
+            ne.infoSize = e.infoSize;
+            writeRecord(&out, RecordKind::Info, o.second, e.stamp,
+                        (const char *)_map + e.infoOffset, e.infoSize);
+            written += recordSize(e.infoSize);
+        }
+
+        if (e.thumbOffset >= 0) {
+            ne.thumbOffset = written + sizeof(RecordHeader);
+            ne.thumbSize = e.thumbSize;
+            writeRecord(&out, RecordKind::Thumb, o.second, e.stamp,
+                        (const char *)_map + e.thumbOffset, e.thumbSize);
+            written += recordSize(e.thumbSize);
+        }
+
+        if (e.stripOffset >= 0) {
+            ne.stripOffset = written + sizeof(RecordHeader);
+            ne.stripSize = e.stripSize;
+            writeRecord(&out, RecordKind::Strip, o.second, e.stamp,
+                        (const char *)_map + e.stripOffset, e.stripSize);
+            written += recordSize(e.stripSize);
+        }
+        index.insert(o.second, ne);
+    }
+
+    if (!out.commit()) {
+        qWarning() << "compact cache failed" << out.errorString();
+        return;
+    }
+
+    qDebug() << "metacache compacted:" << _index.size() << "->" << index.size()
+             << "entries," << _end << "->" << written << "bytes";
+    if (openStore()) {
+        _index = index;
+        _liveBytes = written;
+    } else {
+        _index.clear();
+        _liveBytes = 0;
+    }
+}
+
+}
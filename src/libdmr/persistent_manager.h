@@ -0,0 +1,129 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_PERSISTENT_MANAGER_H
+#define _DMR_PERSISTENT_MANAGER_H
+
+#include <QtGui>
+
+#include "playlist_model.h"
+
+namespace dmr {
+struct FileStamp;
+
+/*
+   class PersistentManager
+   caches MovieInfo, playlist thumbnails and film strips across runs. all
+   records live in one append-only data file that is memory-mapped for
+   reads, an in-memory index built by a single scan at startup points
+   every url to its latest records. superseded, expired and over-budget
+   records are dropped when the file gets compacted.
+*/
+class PersistentManager
+{
+public:
+    static PersistentManager &get();
+    ~PersistentManager();
+
+    struct CacheInfo {
+        struct MovieInfo mi;
+        QImage thumb;
+        bool mi_valid {false};
+        bool thumb_valid {false};
+    };
+
+    CacheInfo loadFromCache(const QUrl &url);
+    void save(const PlayItemInfo &pif);
+    // data is an encoded (png) image, stored as is
+    void saveThumbnail(const QUrl &url, const QByteArray &data);
+    // thumbnail alone, null if there's none or it's stale
+    QImage loadThumbnail(const QUrl &url);
+    bool cacheExists(const QUrl &url);
+
+    // film strips are kept per slice count, side by side in one image
+    QImage loadFilmStrip(const QUrl &url, int count);
+    void saveFilmStrip(const QUrl &url, int count, const QImage &strip);
+
+    // limits enforced by compact(), the app reads them from the
+    // metacache_size (MB) and metacache_max_age (days) options.
+    // compacts right away if the cache is over the new limits
+    void setBudget(qint64 maxBytes, int maxAgeDays);
+    void compact();
+
+    // entries are validated against mtime, size and inode of the file,
+    // this additionally compares utils::FastFileHash (off by default)
+    void setContentHashing(bool on);
+
+private:
+    enum RecordKind {
+        Info = 1,
+        Thumb = 2,
+        Strip = 3,
+    };
+
+    struct Entry {
+        qint64 infoOffset {-1};
+        quint32 infoSize {0};
+        qint64 thumbOffset {-1};
+        quint32 thumbSize {0};
+        qint64 stripOffset {-1};
+        quint32 stripSize {0};
+        qint64 stamp {0};
+    };
+
+    QReadWriteLock _lock;
+    QString _path;
+    QFile _file;
+    uchar *_map {nullptr};
+    qint64 _mapSize {0};
+    // end of the last record, the file is grown ahead of it
+    qint64 _end {0};
+    qint64 _liveBytes {0};
+    QHash<QByteArray, Entry> _index;
+
+    qint64 _maxBytes;
+    int _maxAgeDays;
+    QAtomicInt _hashContent {0};
+
+    PersistentManager();
+
+    bool openStore();
+    bool remap();
+    void scan();
+    void doCompact();
+    // entries stamped before this are expired
+    qint64 expireStamp() const;
+    bool hasExpired() const;
+    bool append(RecordKind kind, const QByteArray &key, const QByteArray &payload);
+    bool isFresh(qint64 offset, const QUrl &url, const struct FileStamp &st) const;
+};
+
+}
+
+#endif /* ifndef _DMR_PERSISTENT_MANAGER_H */
@@ -0,0 +1,186 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "playback_clock.h"
+#include "player_engine.h"
+#include "playlist_model.h"
+#include "playlist_store.h"
+
+namespace dmr {
+
+PlaybackClock::PlaybackClock(PlayerEngine *engine)
+    : QObject(engine), _engine(engine)
+{
+    connect(_engine, &PlayerEngine::elapsedChanged, this, &PlaybackClock::publish);
+    connect(_engine, &PlayerEngine::stateChanged, this, &PlaybackClock::publish);
+    connect(_engine, &PlayerEngine::fileLoaded, this, &PlaybackClock::publish);
+}
+
+PlaybackClock::~PlaybackClock()
+{
+    for (auto &s : _subs) {
+        delete s.timer;
+    }
+}
+
+int PlaybackClock::subscribe(QWidget *w, int hz, const Handler &fn)
+{
+    Q_ASSERT(w);
+    int id = _nextId++;
+
+    Subscriber s;
+    s.widget = w;
+    s.hz = hz;
+    s.fn = fn;
+    s.pending = true;
+    s.timer = new QTimer;
+    s.timer->setSingleShot(true);
+    connect(s.timer, &QTimer::timeout, this, [ = ]() {
+        deliver(id);
+    });
+    _subs.insert(id, s);
+
+    // Show is sent to children too, so this covers the toolbox popping up
+    w->installEventFilter(this);
+    w->window()->installEventFilter(this);
+    connect(w, &QObject::destroyed, this, [ = ]() {
+        unsubscribe(id);
+    });
+
+    deliver(id);
+    return id;
+}
+
+void PlaybackClock::unsubscribe(int id)
+{
+    auto it = _subs.find(id);
+    if (it == _subs.end())
+        return;
+
+    it->timer->deleteLater();
+    _subs.erase(it);
+}
+
+void PlaybackClock::setRate(int id, int hz)
+{
+    auto it = _subs.find(id);
+    if (it == _subs.end() || it->hz == hz)
+        return;
+
+    it->hz = hz;
+    it->timer->stop();
+    deliver(id);
+}
+
+const PlaybackClock::Snapshot &PlaybackClock::snapshot()
+{
+    if (_stale) {
+        auto &pl = _engine->playlist();
+
+        _snapshot.idle = _engine->state() == PlayerEngine::CoreState::Idle;
+        _snapshot.elapsed = _engine->elapsed();
+        _snapshot.duration = _engine->duration();
+        _snapshot.itemDuration = -1;
+        if (pl.current() >= 0 && pl.current() < pl.count()) {
+            _snapshot.itemDuration = pl.items().duration(pl.current());
+        }
+        _snapshot.serial++;
+        _stale = false;
+    }
+    return _snapshot;
+}
+
+void PlaybackClock::publish()
+{
+    _stale = true;
+    for (auto it = _subs.begin(); it != _subs.end(); ++it) {
+        it->pending = true;
+    }
+
+    for (auto id : _subs.keys()) {
+        deliver(id);
+    }
+}
+
+bool PlaybackClock::eventFilter(QObject *obj, QEvent *ev)
+{
+    if (ev->type() == QEvent::Show || ev->type() == QEvent::WindowStateChange) {
+        for (auto id : _subs.keys()) {
+            auto it = _subs.find(id);
+            if (it != _subs.end() && it->pending && it->widget
+                    && (it->widget == obj || it->widget->window() == obj)) {
+                // let the state change settle before checking visibility
+                QTimer::singleShot(0, this, [ = ]() { deliver(id); });
+            }
+        }
+    }
+    return QObject::eventFilter(obj, ev);
+}
+
+void PlaybackClock::deliver(int id)
+{
+    auto it = _subs.find(id);
+    if (it == _subs.end())
+        return;
+
+    if (!it->pending || it->hz == Suspended || it->timer->isActive())
+        return;
+
+    if (!it->widget || !isShowing(it->widget))
+        return;
+
+    it->pending = false;
+    it->timer->setTimerType(it->hz == DisplaySync ? Qt::PreciseTimer : Qt::CoarseTimer);
+    it->timer->start(intervalOf(*it));
+
+    // handler may (un)subscribe, don't touch it afterwards
+    auto fn = it->fn;
+    fn(snapshot());
+}
+
+bool PlaybackClock::isShowing(const QWidget *w) const
+{
+    return w->isVisible() && !w->window()->isMinimized();
+}
+
+int PlaybackClock::intervalOf(const Subscriber &s) const
+{
+    if (s.hz == DisplaySync) {
+        auto *scr = QGuiApplication::primaryScreen();
+        if (auto *wh = s.widget->window()->windowHandle()) {
+            scr = wh->screen();
+        }
+        qreal rate = scr ? scr->refreshRate() : 60.0;
+        return qMax(1, qRound(1000.0 / qMax(rate, 1.0)));
+    }
+
+    return 1000 / qMax(s.hz, 1);
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_PLAYBACK_CLOCK_H
+#define _DMR_PLAYBACK_CLOCK_H
+
+#include <QtWidgets>
+#include <functional>
+
+namespace dmr {
+class PlayerEngine;
+
+/*
+   class PlaybackClock
+   single source of playback position for widgets. the backend reports
+   time-pos at its own (high) rate, the clock coalesces those reports and
+   hands each subscriber one shared snapshot at the rate it asked for.
+   nothing is delivered while the subscribed widget is hidden or its
+   window is minimized, the latest snapshot is delivered once it shows up.
+*/
+class PlaybackClock: public QObject
+{
+    Q_OBJECT
+public:
+    enum Rate {
+        Suspended = 0,
+        DisplaySync = -1, // once per refresh of the screen the widget is on
+        LabelRate = 4,
+    };
+
+    struct Snapshot {
+        bool idle {true};
+        qint64 elapsed {0};      // secs
+        qint64 duration {0};     // secs, as reported by backend
+        qint64 itemDuration {0}; // secs, from movie info of current item
+        quint64 serial {0};
+    };
+    using Handler = std::function<void(const Snapshot &)>;
+
+    explicit PlaybackClock(PlayerEngine *engine);
+    ~PlaybackClock();
+
+    // returns an id for setRate/unsubscribe, the subscription goes away
+    // with the widget
+    int subscribe(QWidget *w, int hz, const Handler &fn);
+    void unsubscribe(int id);
+    void setRate(int id, int hz);
+
+    const Snapshot &snapshot();
+
+public slots:
+    // marks the snapshot stale and notifies subscribers that are due
+    void publish();
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *ev) override;
+
+private:
+    struct Subscriber {
+        QPointer<QWidget> widget;
+        int hz {Suspended};
+        Handler fn;
+        QTimer *timer {nullptr};
+        bool pending {false};
+    };
+
+    PlayerEngine *_engine {nullptr};
+    QMap<int, Subscriber> _subs;
+    int _nextId {1};
+    Snapshot _snapshot;
+    bool _stale {true};
+
+    void deliver(int id);
+    bool isShowing(const QWidget *w) const;
+    int intervalOf(const Subscriber &s) const;
+};
+
+}
+
+#endif /* ifndef _DMR_PLAYBACK_CLOCK_H */
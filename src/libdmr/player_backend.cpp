@@ -31,4 +31,5 @@
 
 namespace dmr {
 Backend::DebugLevel Backend::_debugLevel = Backend::DebugLevel::Info;
+Backend::HeadlessMode Backend::_headlessMode = Backend::HeadlessMode::NoHeadless;
 }
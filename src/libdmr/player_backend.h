@@ -69,6 +69,16 @@ public:
     };
     Q_ENUM(DebugLevel)
 
+    // no display at all: decode and time the pipeline only, for test
+    // harnesses and benchmarks. a QApplication is still needed, run it
+    // with QT_QPA_PLATFORM=offscreen when there's no X server
+    enum HeadlessMode {
+        NoHeadless,
+        HeadlessNull,     // frames are dropped by the vo
+        HeadlessSoftware  // frames are rendered on the cpu into memory
+    };
+    Q_ENUM(HeadlessMode)
+
     Backend(QWidget *parent = 0) {}
     virtual ~Backend() {}
 
@@ -126,6 +136,9 @@ public:
     virtual void previousFrame() = 0;
 
     static void setDebugLevel(DebugLevel lvl) { _debugLevel = lvl; }
+    // must be set before the PlayerEngine gets created
+    static void setHeadlessMode(HeadlessMode m) { _headlessMode = m; }
+    static HeadlessMode headlessMode() { return _headlessMode; }
 
 Q_SIGNALS:
     void tracksChanged();
@@ -163,6 +176,7 @@ protected:
     QString _dvdDevice {"/dev/sr0"};
     QUrl _file;
     static DebugLevel _debugLevel;
+    static HeadlessMode _headlessMode;
 };
 }
 
@@ -31,6 +31,9 @@
 
 #include "player_engine.h"
 #include "playlist_model.h"
+#include "playlist_store.h"
+#include "playback_clock.h"
+#include "dir_scanner.h"
 #include "movie_configuration.h"
 #include "online_sub.h"
 
@@ -69,6 +72,10 @@ PlayerEngine::PlayerEngine(QWidget *parent)
         l->addWidget(_current);
     }
 
+    if (auto *mpv = dynamic_cast<MpvProxy *>(_current)) {
+        connect(mpv, &MpvProxy::queuedFileStarted, this, &PlayerEngine::onQueuedFileStarted);
+    }
+
     connect(&_networkConfigMng, &QNetworkConfigurationManager::onlineStateChanged, this, &PlayerEngine::onlineStateChanged);
 
     setLayout(l);
@@ -84,10 +91,25 @@ PlayerEngine::PlayerEngine(QWidget *parent)
     _playlist = new PlaylistModel(this);
     connect(_playlist, &PlaylistModel::asyncAppendFinished, this,
             &PlayerEngine::onPlaylistAsyncAppendFinished);
+    connect(_playlist, &PlaylistModel::sortedBlockFinished, this,
+            &PlayerEngine::onSortedBlockFinished);
+
+    _scanner = new DirScanner(this);
+    connect(_scanner, &DirScanner::found, this, &PlayerEngine::onScanFound);
+    connect(_scanner, &DirScanner::finished, this, &PlayerEngine::onScanFinished);
+
+    _clock = new PlaybackClock(this);
 }
 
 PlayerEngine::~PlayerEngine()
 {
+    delete _clock;
+    _clock = nullptr;
+
+    // waits for the walks to stop, nothing can be appended after this
+    delete _scanner;
+    _scanner = nullptr;
+
     disconnect(_playlist, 0, 0, 0);
     delete _playlist;
     _playlist = nullptr;
@@ -206,13 +228,37 @@ void PlayerEngine::updateSubStyles()
 #endif
 }
 
-void PlayerEngine::waitLastEnd()
+void PlayerEngine::waitLastEnd(const std::function<void()> &cont)
 {
     if (auto *mpv = dynamic_cast<MpvProxy *>(_current)) {
-        mpv->pollingEndOfPlayback();
+        mpv->whenPlaybackEnded(cont);
+    } else if (cont) {
+        cont();
     }
 }
 
+void PlayerEngine::queueNext(int id)
+{
+    auto *mpv = dynamic_cast<MpvProxy *>(_current);
+    if (!mpv) return;
+
+    QUrl url;
+    if (id >= 0 && id < _playlist->count()) {
+        url = _playlist->items().url(id);
+    }
+    mpv->queueNext(url);
+}
+
+void PlayerEngine::onQueuedFileStarted(const QUrl &url)
+{
+    DRecentData data;
+    data.appName = "Deepin Movie";
+    data.appExec = "deepin-movie";
+    DRecentManager::addItem(url.toLocalFile(), data);
+
+    _playlist->advanceToQueued(url);
+}
+
 void PlayerEngine::onBackendStateChanged()
 {
     if (!_current) return;
@@ -474,13 +520,13 @@ void PlayerEngine::requestPlay(int id)
     if (!_current) return;
     if (id >= _playlist->count()) return;
 
-    const auto &item = _playlist->items()[id];
-    _current->setPlayFile(item.url);
+    const auto &url = _playlist->items().url(id);
+    _current->setPlayFile(url);
 
     DRecentData data;
     data.appName = "Deepin Movie";
     data.appExec = "deepin-movie";
-    DRecentManager::addItem(item.url.toLocalFile(), data);
+    DRecentManager::addItem(url.toLocalFile(), data);
 
     if (_current->isPlayable()) {
         _current->play();
@@ -544,7 +590,14 @@ void PlayerEngine::onPlaylistAsyncAppendFinished(const QList<PlayItemInfo> &pil)
     if (_pendingPlayReq.isValid()) {
         auto id = _playlist->indexOf(_pendingPlayReq);
         if (pil.size() && _pendingPlayReq.scheme() == "playlist") {
-            id = _playlist->indexOf(pil[0].url);
+            // files of a folder still being scanned are not final, the
+            // first of them is known once the folder is done
+            for (const auto &pif : pil) {
+                if (!_playlist->inSortedBlock(pif.url)) {
+                    id = _playlist->indexOf(pif.url);
+                    break;
+                }
+            }
         }
 
         if (id >= 0) {
@@ -555,6 +608,26 @@ void PlayerEngine::onPlaylistAsyncAppendFinished(const QList<PlayItemInfo> &pil)
     }
 }
 
+void PlayerEngine::onSortedBlockFinished(const QString &root, const QUrl &first)
+{
+    if (!_pendingPlayReq.isValid()) return;
+
+    bool forRoot = _pendingPlayReq.isLocalFile()
+                   && QDir(_pendingPlayReq.toLocalFile()).absolutePath() == root;
+    if (!forRoot && _pendingPlayReq.scheme() != "playlist") return;
+
+    // the folder is in the list sorted as a whole now, start on its first
+    auto id = first.isValid() ? _playlist->indexOf(first) : -1;
+    if (id >= 0) {
+        _playlist->changeCurrent(id);
+        _pendingPlayReq = QUrl();
+    } else if (forRoot) {
+        // nothing new from the folder (all listed already, or none could
+        // be probed), a stale request would catch the next unrelated append
+        _pendingPlayReq = QUrl();
+    }
+}
+
 void PlayerEngine::playByName(const QUrl &url)
 {
     savePreviousMovieState();
@@ -574,6 +647,12 @@ void PlayerEngine::playSelected(int id)
 
 void PlayerEngine::clearPlaylist()
 {
+    // batches already on their way are dropped by onScanFound
+    _scanner->cancelAll();
+    for (const auto &root : _scans) {
+        _playlist->endSortedBlock(root.toLocalFile());
+    }
+    _scans.clear();
     _playlist->clear();
 }
 
@@ -653,17 +732,31 @@ bool PlayerEngine::addPlayFile(const QUrl &url)
     return false;
 }
 
+// same set isPlayableFile(name) accepts, as DirScanner wants it
+static const QSet<QByteArray> &PlayableSuffixes()
+{
+    static QSet<QByteArray> suffixes;
+    if (suffixes.isEmpty()) {
+        for (const auto &t : video_filetypes) {
+            suffixes.insert(t.mid(t.indexOf('.') + 1).toLower().toLatin1());
+        }
+    }
+    return suffixes;
+}
+
 QList<QUrl> PlayerEngine::collectPlayDir(const QDir &dir)
 {
     QList<QUrl> urls;
+    QMutex lock;
 
-    QDirIterator di(dir, QDirIterator::Subdirectories);
-    while (di.hasNext()) {
-        di.next();
-        if (di.fileInfo().isFile() && isPlayableFile(di.fileName())) {
-            urls.append(QUrl::fromLocalFile(di.filePath()));
-        }
-    }
+    DirScanner scanner;
+    // no context object, so the hits are taken in the pool threads
+    connect(&scanner, &DirScanner::found, [&](int, const QList<QUrl> &hits) {
+        QMutexLocker l(&lock);
+        urls += hits;
+    });
+    scanner.scan(dir.absolutePath(), PlayableSuffixes());
+    scanner.waitForDone();
 
     return urls;
 }
@@ -675,15 +768,54 @@ QList<QUrl> PlayerEngine::addPlayDir(const QDir &dir)
     return valids;
 }
 
+void PlayerEngine::scanPlayDir(const QDir &dir)
+{
+    // hits stream in batches, the playlist sorts them into one run
+    _playlist->beginSortedBlock(dir.absolutePath());
+    auto id = _scanner->scan(dir.absolutePath(), PlayableSuffixes());
+    _scans.insert(id, QUrl::fromLocalFile(dir.absolutePath()));
+}
+
+void PlayerEngine::onScanFound(int id, const QList<QUrl> &urls)
+{
+    if (!_scans.contains(id)) return;
+    _playlist->appendAsync(urls);
+}
+
+void PlayerEngine::onScanFinished(int id, int total, bool cancelled)
+{
+    auto root = _scans.take(id);
+    qDebug() << "scan of" << root << "found" << total << (cancelled ? "(cancelled)" : "");
+    // the pending request is settled by onSortedBlockFinished
+    if (root.isValid()) {
+        _playlist->endSortedBlock(root.toLocalFile());
+    }
+}
 
 QList<QUrl> PlayerEngine::addPlayFiles(const QList<QUrl> &urls)
 {
-    QList<QUrl> valids = collectPlayFiles(urls);
+    QList<QUrl> dirs;
+    QList<QUrl> valids = collectPlayFiles(urls, &dirs);
     _playlist->appendAsync(valids);
-    return valids;
+
+    for (const auto &url : dirs) {
+        scanPlayDir(url.toLocalFile());
+    }
+    return valids + dirs;
 }
 
 QList<QUrl> PlayerEngine::collectPlayFiles(const QList<QUrl> &urls)
+{
+    QList<QUrl> dirs;
+    QList<QUrl> valids = collectPlayFiles(urls, &dirs);
+    for (const auto &url : dirs) {
+        valids += collectPlayDir(url.toLocalFile());
+        valids += url;
+    }
+    return valids;
+}
+
+QList<QUrl> PlayerEngine::collectPlayFiles(const QList<QUrl> &urls, QList<QUrl> *dirs)
 {
     qDebug() << urls;
     //NOTE: take care of loop, we don't recursive, it seems safe now
@@ -697,9 +829,9 @@ QList<QUrl> PlayerEngine::collectPlayFiles(const QList<QUrl> &urls)
             }
 
             if (fi.isDir()) {
-                auto subs = collectPlayDir(fi.absoluteFilePath());
-                valids += subs;
-                valids += url;
+                if (dirs) {
+                    dirs->append(QUrl::fromLocalFile(fi.absoluteFilePath()));
+                }
                 continue;
             }
 
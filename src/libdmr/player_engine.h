@@ -36,9 +36,12 @@
 #include <player_backend.h>
 #include <online_sub.h>
 #include <QNetworkConfigurationManager>
+#include <functional>
 
 namespace dmr {
 class PlaylistModel;
+class PlaybackClock;
+class DirScanner;
 
 using SubtitleInfo = QMap<QString, QVariant>;
 using AudioInfo = QMap<QString, QVariant>;
@@ -75,9 +78,14 @@ public:
 
     /* backend like mpv will asynchronously report end of playback.
      * there are situations when we need to see the end-event before
-     * proceed (e.g playlist next)
+     * proceed (e.g playlist next). this stops current playback and runs
+     * cont once the end-event arrived, or right away if nothing plays.
+     * the event loop keeps running meanwhile.
      */
-    void waitLastEnd();
+    void waitLastEnd(const std::function<void()> &cont = nullptr);
+    // lets the backend open item id ahead so it follows the current one
+    // without a gap, -1 drops what was queued
+    void queueNext(int id);
 
     friend class PlaylistModel;
 
@@ -89,7 +97,12 @@ public:
 
     bool addPlayFile(const QUrl &url);
     QList<QUrl> addPlayDir(const QDir &dir); // return collected valid urls
-    //returned list contains only accepted valid items
+    // files are appended in batches while the tree is scanned in the
+    // background, playByName() on the dir url plays the first one by
+    // name once the whole tree is in
+    void scanPlayDir(const QDir &dir);
+    //returned list contains only accepted valid items, dirs given are
+    //listed after the files and scanned like scanPlayDir()
     QList<QUrl> addPlayFiles(const QList<QUrl> &urls);
 
     bool isPlayableFile(const QUrl &url);
@@ -142,6 +155,12 @@ public:
         return _playlist;
     };
 
+    // rate-limited position updates, prefer it over elapsedChanged in ui
+    PlaybackClock &clock() const
+    {
+        return *_clock;
+    }
+
     QImage takeScreenshot();
     void burstScreenshot(); //initial the start of burst screenshotting
     void stopBurstScreenshot();
@@ -206,17 +225,28 @@ protected slots:
     void onSubtitlesDownloaded(const QUrl &url, const QList<QString> &filenames,
                                OnlineSubtitle::FailReason);
     void onPlaylistAsyncAppendFinished(const QList<PlayItemInfo> &);
+    void onScanFound(int id, const QList<QUrl> &urls);
+    void onScanFinished(int id, int total, bool cancelled);
+    void onSortedBlockFinished(const QString &root, const QUrl &first);
+    void onQueuedFileStarted(const QUrl &url);
 
 protected:
     PlaylistModel *_playlist {nullptr};
+    PlaybackClock *_clock {nullptr};
     CoreState _state { CoreState::Idle };
     Backend *_current {nullptr};
 
     QUrl _pendingPlayReq;
 
+    DirScanner *_scanner {nullptr};
+    QHash<int, QUrl> _scans; // running scans by id, with their root
+
     bool _playingRequest {false};
 
     QList<QUrl> collectPlayFiles(const QList<QUrl> &urls);
+    // dirs met are left out and collected into dirs
+    QList<QUrl> collectPlayFiles(const QList<QUrl> &urls, QList<QUrl> *dirs);
+    // walks dir with a DirScanner and waits for it
     QList<QUrl> collectPlayDir(const QDir &dir);
 
     void resizeEvent(QResizeEvent *re) override;
@@ -0,0 +1,294 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "playlist_journal.h"
+
+namespace dmr {
+
+static const QByteArray kMagic = "DMRPL 1\n";
+// how long a burst of edits may keep coming before it's written
+static const int kCommitDelay = 500;
+// log records allowed on top of twice the live items before a rewrite
+static const int kCompactSlack = 1024;
+
+PlaylistJournal::PlaylistJournal(const QString &path, QObject *parent)
+    : QThread(parent), _path {path}
+{
+}
+
+PlaylistJournal::~PlaylistJournal()
+{
+    stop();
+}
+
+bool PlaylistJournal::exists() const
+{
+    return QFile::exists(_path);
+}
+
+QList<QUrl> PlaylistJournal::load()
+{
+    _urls.clear();
+    _records = 0;
+
+    QFile f(_path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return _urls;
+    }
+
+    if (f.readLine() != kMagic) {
+        qWarning() << "playlist journal: unknown format" << _path;
+        // records would be appended behind the broken header and never
+        // read back, the file is rewritten with a valid one instead
+        QMutexLocker lock(&_lock);
+        _snapshot = _urls;
+        _hasSnapshot = true;
+        return _urls;
+    }
+
+    while (!f.atEnd()) {
+        auto record = f.readLine();
+        // only the last record can be torn by a crash, everything before it holds
+        if (!record.endsWith('\n') || !replay(_urls, record.left(record.size() - 1))) {
+            qWarning() << "playlist journal: bad record" << _records << "in" << _path;
+            // anything appended after the bad record would never be replayed
+            QMutexLocker lock(&_lock);
+            _snapshot = _urls;
+            _hasSnapshot = true;
+            break;
+        }
+        _records++;
+    }
+
+    return _urls;
+}
+
+void PlaylistJournal::append(const QUrl &url)
+{
+    enqueue("A " + url.toEncoded());
+}
+
+void PlaylistJournal::remove(int pos)
+{
+    enqueue("R " + QByteArray::number(pos));
+}
+
+void PlaylistJournal::move(int from, int to)
+{
+    enqueue("M " + QByteArray::number(from) + ' ' + QByteArray::number(to));
+}
+
+void PlaylistJournal::clear()
+{
+    enqueue("C");
+}
+
+void PlaylistJournal::reset(const QList<QUrl> &urls)
+{
+    QMutexLocker lock(&_lock);
+    _pending.clear();
+    _snapshot = urls;
+    _hasSnapshot = true;
+    _cond.wakeOne();
+}
+
+void PlaylistJournal::stop()
+{
+    if (!isRunning()) return;
+
+    {
+        QMutexLocker lock(&_lock);
+        _quit.store(1);
+        _cond.wakeAll();
+    }
+    wait();
+}
+
+void PlaylistJournal::enqueue(const QByteArray &record)
+{
+    QMutexLocker lock(&_lock);
+    _pending.append(record);
+    _cond.wakeOne();
+}
+
+bool PlaylistJournal::replay(QList<QUrl> &urls, const QByteArray &record)
+{
+    if (record.isEmpty()) return false;
+
+    auto args = record.mid(2);
+    bool ok = false;
+    switch (record.at(0)) {
+    case 'A': {
+        auto url = QUrl::fromEncoded(args);
+        if (!url.isValid()) return false;
+        urls.append(url);
+        return true;
+    }
+
+    case 'R': {
+        int pos = args.toInt(&ok);
+        if (!ok || pos < 0 || pos >= urls.size()) return false;
+        urls.removeAt(pos);
+        return true;
+    }
+
+    case 'M': {
+        auto l = args.split(' ');
+        if (l.size() != 2) return false;
+        int from = l[0].toInt(&ok);
+        if (!ok) return false;
+        int to = l[1].toInt(&ok);
+        if (!ok || from < 0 || from >= urls.size() || to < 0 || to >= urls.size()) return false;
+        urls.move(from, to);
+        return true;
+    }
+
+    case 'C':
+        urls.clear();
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool PlaylistJournal::write(const QList<QByteArray> &records)
+{
+    if (!QFile::exists(_path)) {
+        QDir().mkpath(QFileInfo(_path).absolutePath());
+    }
+
+    QFile f(_path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "playlist journal: can not open" << _path << f.errorString();
+        return false;
+    }
+
+    QByteArray data;
+    if (f.size() == 0) {
+        data += kMagic;
+    }
+    for (const auto &r : records) {
+        data += r;
+        data += '\n';
+    }
+
+    if (f.write(data) != data.size()) {
+        qWarning() << "playlist journal: write failed" << f.errorString();
+        return false;
+    }
+    _records += records.size();
+    return true;
+}
+
+bool PlaylistJournal::rewrite()
+{
+    QDir().mkpath(QFileInfo(_path).absolutePath());
+
+    QSaveFile f(_path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "playlist journal: can not open" << _path << f.errorString();
+        return false;
+    }
+
+    QByteArray data = kMagic;
+    for (const auto &url : _urls) {
+        data += "A " + url.toEncoded() + '\n';
+    }
+    f.write(data);
+
+    if (!f.commit()) {
+        qWarning() << "playlist journal: rewrite failed" << f.errorString();
+        return false;
+    }
+    _records = _urls.size();
+    return true;
+}
+
+void PlaylistJournal::run()
+{
+    setPriority(QThread::LowPriority);
+
+    forever {
+        QList<QByteArray> records;
+        QList<QUrl> snapshot;
+        bool hasSnapshot = false;
+        bool quit = false;
+        {
+            QMutexLocker lock(&_lock);
+            while (_pending.isEmpty() && !_hasSnapshot && !_quit.load()) {
+                _cond.wait(&_lock);
+            }
+
+            // let the rest of the burst arrive, so it lands in one write
+            QElapsedTimer t;
+            t.start();
+            while (!_quit.load() && t.elapsed() < kCommitDelay) {
+                _cond.wait(&_lock, kCommitDelay - t.elapsed());
+            }
+
+            quit = _quit.load();
+            records.swap(_pending);
+            if (_hasSnapshot) {
+                snapshot.swap(_snapshot);
+                hasSnapshot = true;
+                _hasSnapshot = false;
+            }
+        }
+
+        // records still queued were issued after the reset
+        if (hasSnapshot) {
+            _urls = snapshot;
+            rewrite();
+        }
+
+        if (!records.isEmpty()) {
+            QList<QByteArray> applied;
+            for (const auto &r : records) {
+                if (replay(_urls, r)) {
+                    applied.append(r);
+                } else {
+                    qWarning() << "playlist journal: dropped record" << r;
+                }
+            }
+
+            if (_records + applied.size() > 2 * _urls.size() + kCompactSlack) {
+                rewrite();
+            } else if (!applied.isEmpty()) {
+                write(applied);
+            }
+        }
+
+        if (quit) break;
+    }
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_PLAYLIST_JOURNAL_H
+#define _DMR_PLAYLIST_JOURNAL_H
+
+#include <QtCore>
+
+namespace dmr {
+
+/*
+   class PlaylistJournal
+   persistent playlist kept as an append-only log of edits (append,
+   remove, move, clear) on top of a snapshot. the model only queues
+   records, the worker batches them for a short while and appends them to
+   the file, so a save costs as much as the change that caused it.
+   the log is rewritten as a plain snapshot once it holds far more
+   records than live items. loading is a single sequential replay.
+*/
+class PlaylistJournal: public QThread
+{
+    Q_OBJECT
+public:
+    PlaylistJournal(const QString &path, QObject *parent = nullptr);
+    ~PlaylistJournal();
+
+    bool exists() const;
+    // replays the log, call before start()
+    QList<QUrl> load();
+
+    void append(const QUrl &url);
+    void remove(int pos);
+    // same semantics as QList::move
+    void move(int from, int to);
+    void clear();
+    // drops whatever is queued and rewrites the log as exactly urls
+    void reset(const QList<QUrl> &urls);
+
+    // writes out queued records and ends the worker
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    QString _path;
+    QMutex _lock;
+    QWaitCondition _cond;
+    QList<QByteArray> _pending;
+    QList<QUrl> _snapshot;
+    bool _hasSnapshot {false};
+    QAtomicInt _quit {0};
+
+    // worker side: the list as the file describes it
+    QList<QUrl> _urls;
+    int _records {0};
+
+    void enqueue(const QByteArray &record);
+    static bool replay(QList<QUrl> &urls, const QByteArray &record);
+    bool write(const QList<QByteArray> &records);
+    bool rewrite();
+};
+
+}
+
+#endif /* ifndef _DMR_PLAYLIST_JOURNAL_H */
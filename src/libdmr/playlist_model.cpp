@@ -34,9 +34,13 @@
 #include "dmr_settings.h"
 #endif
 #include "dvd_utils.h"
+#include "movie_prober.h"
+#include "persistent_manager.h"
+#include "playlist_thumbnailer.h"
+#include "playlist_store.h"
+#include "playlist_journal.h"
 
 
-#include <libffmpegthumbnailer/videothumbnailer.h>
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/dict.h>
@@ -45,53 +49,6 @@ extern "C" {
 
 #include <random>
 
-static int open_codec_context(int *stream_idx,
-                              AVCodecContext **dec_ctx, AVFormatContext *fmt_ctx, enum AVMediaType type)
-{
-    int ret, stream_index;
-    AVStream *st;
-    AVCodec *dec = NULL;
-    AVDictionary *opts = NULL;
-    ret = av_find_best_stream(fmt_ctx, type, -1, -1, NULL, 0);
-    if (ret < 0) {
-        qWarning() << "Could not find " << av_get_media_type_string(type)
-                   << " stream in input file";
-        return ret;
-    }
-
-    stream_index = ret;
-    st = fmt_ctx->streams[stream_index];
-#if LIBAVFORMAT_VERSION_MAJOR >= 57 && LIBAVFORMAT_VERSION_MINOR <= 25
-    *dec_ctx = st->codec;
-    dec = avcodec_find_decoder((*dec_ctx)->codec_id);
-#else
-    /* find decoder for the stream */
-    dec = avcodec_find_decoder(st->codecpar->codec_id);
-    if (!dec) {
-        fprintf(stderr, "Failed to find %s codec\n",
-                av_get_media_type_string(type));
-        return AVERROR(EINVAL);
-    }
-    /* Allocate a codec context for the decoder */
-    *dec_ctx = avcodec_alloc_context3(dec);
-    if (!*dec_ctx) {
-        fprintf(stderr, "Failed to allocate the %s codec context\n",
-                av_get_media_type_string(type));
-        return AVERROR(ENOMEM);
-    }
-    /* Copy codec parameters from input stream to output codec context */
-    if ((ret = avcodec_parameters_to_context(*dec_ctx, st->codecpar)) < 0) {
-        fprintf(stderr, "Failed to copy %s codec parameters to decoder context\n",
-                av_get_media_type_string(type));
-        return ret;
-    }
-#endif
-
-    *stream_idx = stream_index;
-    return 0;
-}
-
-
 namespace dmr {
 QDebug operator<<(QDebug debug, const struct MovieInfo &mi)
 {
@@ -170,240 +127,9 @@ QDataStream &operator>> (QDataStream &st, MovieInfo &mi)
     return st;
 }
 
-static class PersistentManager *_persistentManager = nullptr;
-
-static QString hashUrl(const QUrl &url)
-{
-    return QString(QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha256).toHex());
-}
-
-//TODO: clean cache periodically
-class PersistentManager: public QObject
-{
-    Q_OBJECT
-public:
-    static PersistentManager &get()
-    {
-        if (!_persistentManager) {
-            _persistentManager = new PersistentManager;
-        }
-        return *_persistentManager;
-    }
-
-    struct CacheInfo {
-        struct MovieInfo mi;
-        QPixmap thumb;
-        bool mi_valid {false};
-        bool thumb_valid {false};
-    };
-
-    CacheInfo loadFromCache(const QUrl &url)
-    {
-        auto h = hashUrl(url);
-        CacheInfo ci;
-
-        {
-            auto filename = QString("%1/%2").arg(_cacheInfoPath).arg(h);
-            QFile f(filename);
-            if (!f.exists()) return ci;
-
-            if (f.open(QIODevice::ReadOnly)) {
-                QDataStream ds(&f);
-                ds >> ci.mi;
-                ci.mi_valid = ci.mi.valid;
-            } else {
-                qWarning() << f.errorString();
-            }
-        }
-
-        if (ci.mi_valid) {
-            auto filename = QString("%1/%2").arg(_pixmapCachePath).arg(h);
-            QFile f(filename);
-            if (!f.exists()) return ci;
-
-            if (f.open(QIODevice::ReadOnly)) {
-                QDataStream ds(&f);
-                ds >> ci.thumb;
-                ci.thumb.setDevicePixelRatio(qApp->devicePixelRatio());
-                ci.thumb_valid = !ci.thumb.isNull();
-            } else {
-                qWarning() << f.errorString();
-            }
-        }
-
-        return ci;
-    }
-
-    void save(const PlayItemInfo &pif)
-    {
-        auto h = hashUrl(pif.url);
-
-        bool mi_saved = false;
-
-        {
-            auto filename = QString("%1/%2").arg(_cacheInfoPath).arg(h);
-            QFile f(filename);
-            if (f.open(QIODevice::WriteOnly)) {
-                QDataStream ds(&f);
-                ds << pif.mi;
-                mi_saved = true;
-                qDebug() << "cache" << pif.url << "->" << h;
-            } else {
-                qWarning() << f.errorString();
-            }
-        }
-
-        if (mi_saved) {
-            auto filename = QString("%1/%2").arg(_pixmapCachePath).arg(h);
-            QFile f(filename);
-            if (f.open(QIODevice::WriteOnly)) {
-                QDataStream ds(&f);
-                ds << pif.thumbnail;
-            } else {
-                qWarning() << f.errorString();
-            }
-        }
-    }
-
-    bool cacheExists(const QUrl &url)
-    {
-        auto h = hashUrl(url);
-        auto filename = QString("%1/%2").arg(_cacheInfoPath).arg(h);
-        return QFile::exists(filename);
-    }
-
-private:
-    PersistentManager()
-    {
-        auto tmpl = QString("%1/%2/%3/%4")
-                    .arg(QStandardPaths::writableLocation(QStandardPaths::ConfigLocation))
-                    .arg(qApp->organizationName())
-                    .arg(qApp->applicationName());
-        {
-            _cacheInfoPath = tmpl.arg("cacheinfo");
-            QDir d;
-            d.mkpath(_cacheInfoPath);
-        }
-        {
-            _pixmapCachePath = tmpl.arg("thumbs");
-            QDir d;
-            d.mkpath(_pixmapCachePath);
-        }
-    }
-
-    QString _pixmapCachePath;
-    QString _cacheInfoPath;
-
-};
-
 struct MovieInfo MovieInfo::parseFromFile(const QFileInfo &fi, bool *ok)
 {
-    struct MovieInfo mi;
-    mi.valid = false;
-    AVFormatContext *av_ctx = NULL;
-    int stream_id = -1;
-    AVCodecContext *dec_ctx = NULL;
-
-    if (!fi.exists()) {
-        if (ok) *ok = false;
-        return mi;
-    }
-
-    auto ret = avformat_open_input(&av_ctx, fi.filePath().toUtf8().constData(), NULL, NULL);
-    if (ret < 0) {
-        qWarning() << "avformat: could not open input";
-        if (ok) *ok = false;
-        return mi;
-    }
-
-    if (avformat_find_stream_info(av_ctx, NULL) < 0) {
-        qWarning() << "av_find_stream_info failed";
-        if (ok) *ok = false;
-        return mi;
-    }
-
-    if (av_ctx->nb_streams == 0) {
-        if (ok) *ok = false;
-        return mi;
-    }
-    if (open_codec_context(&stream_id, &dec_ctx, av_ctx, AVMEDIA_TYPE_VIDEO) < 0) {
-        if (open_codec_context(&stream_id, &dec_ctx, av_ctx, AVMEDIA_TYPE_AUDIO) < 0) {
-            if (ok) *ok = false;
-            return mi;
-        }
-    }
-
-    av_dump_format(av_ctx, 0, fi.fileName().toUtf8().constData(), 0);
-
-    mi.width = dec_ctx->width;
-    mi.height = dec_ctx->height;
-    auto duration = av_ctx->duration == AV_NOPTS_VALUE ? 0 : av_ctx->duration;
-    duration = duration + (duration <= INT64_MAX - 5000 ? 5000 : 0);
-    mi.duration = duration / AV_TIME_BASE;
-    mi.resolution = QString("%1x%2").arg(mi.width).arg(mi.height);
-    mi.title = fi.fileName(); //FIXME this
-    mi.filePath = fi.canonicalFilePath();
-    mi.creation = fi.created().toString();
-    mi.fileSize = fi.size();
-    mi.fileType = fi.suffix();
-
-    mi.vCodecID = dec_ctx->codec_id;
-    mi.vCodeRate = dec_ctx->bit_rate;
-    if (dec_ctx->framerate.den != 0) {
-        mi.fps = dec_ctx->framerate.num / dec_ctx->framerate.den;
-    } else {
-        mi.fps = 0;
-    }
-    if (mi.height != 0) {
-        mi.proportion = mi.width / mi.height;
-    } else {
-        mi.proportion = 0;
-    }
-
-    if (open_codec_context(&stream_id, &dec_ctx, av_ctx, AVMEDIA_TYPE_AUDIO) < 0) {
-        if (open_codec_context(&stream_id, &dec_ctx, av_ctx, AVMEDIA_TYPE_VIDEO) < 0) {
-            if (ok) *ok = false;
-            return mi;
-        }
-    }
-    mi.aCodeID = dec_ctx->codec_id;
-    mi.aCodeRate = dec_ctx->bit_rate;
-    mi.aDigit = dec_ctx->sample_fmt;
-    mi.channels = dec_ctx->channels;
-    mi.sampling = dec_ctx->sample_rate;
-
-    AVDictionaryEntry *tag = NULL;
-    while ((tag = av_dict_get(av_ctx->metadata, "", tag, AV_DICT_IGNORE_SUFFIX)) != NULL) {
-        if (tag->key && strcmp(tag->key, "creation_time") == 0) {
-            auto dt = QDateTime::fromString(tag->value, Qt::ISODate);
-            mi.creation = dt.toString();
-            qDebug() << __func__ << dt.toString();
-            break;
-        }
-        qDebug() << "tag:" << tag->key << tag->value;
-    }
-
-    tag = NULL;
-    AVStream *st = av_ctx->streams[stream_id];
-    while ((tag = av_dict_get(st->metadata, "", tag, AV_DICT_IGNORE_SUFFIX)) != NULL) {
-        if (tag->key && strcmp(tag->key, "rotate") == 0) {
-            mi.raw_rotate = QString(tag->value).toInt();
-            auto vr = (mi.raw_rotate + 360) % 360;
-            if (vr == 90 || vr == 270) {
-                auto tmp = mi.height;
-                mi.height = mi.width;
-                mi.width = tmp;
-            }
-            break;
-        }
-        qDebug() << "tag:" << tag->key << tag->value;
-    }
-
-    avformat_close_input(&av_ctx);
-    mi.valid = true;
-
-    if (ok) *ok = true;
-    return mi;
+    return MovieProber::get().probe(fi, ok);
 }
 
 bool PlayItemInfo::refresh()
@@ -424,7 +150,6 @@ bool PlayItemInfo::refresh()
 PlaylistModel::PlaylistModel(PlayerEngine *e)
     : _engine(e)
 {
-    _thumbnailer.setThumbnailSize(400 * qApp->devicePixelRatio());
     av_register_all();
 
     _playlistFile = QString("%1/%2/%3/playlist")
@@ -436,12 +161,13 @@ PlaylistModel::PlaylistModel(PlayerEngine *e)
         qDebug() << "model" << "_userRequestingItem" << _userRequestingItem << "state" << e->state();
         switch (e->state()) {
         case PlayerEngine::Playing: {
-            auto &pif = currentInfo();
+            auto pif = currentInfo();
             if (!pif.url.isLocalFile() && !pif.loaded) {
                 pif.mi.width = e->videoSize().width();
                 pif.mi.height = e->videoSize().height();
                 pif.mi.duration = e->duration();
                 pif.loaded = true;
+                _store->update(_current >= 0 ? _current : (_last >= 0 ? _last : 0), pif);
                 emit itemInfoUpdated(_current);
             }
             break;
@@ -450,7 +176,9 @@ PlaylistModel::PlaylistModel(PlayerEngine *e)
             break;
 
         case PlayerEngine::Idle:
-            if (!_userRequestingItem) {
+            // a switch waiting for the end of the last item stops it
+            // on purpose, that's not the end of this item
+            if (!_userRequestingItem && _switchDone == _switchSerial) {
                 stop();
                 playNext(false);
             }
@@ -458,14 +186,34 @@ PlaylistModel::PlaylistModel(PlayerEngine *e)
         }
     });
 
+    connect(e, &PlayerEngine::fileLoaded, this, &PlaylistModel::queueNext);
+    connect(this, &PlaylistModel::countChanged, this, &PlaylistModel::queueNext);
+    connect(this, &PlaylistModel::playModeChanged, this, &PlaylistModel::queueNext);
+
+    _store = new PlaylistStore;
+
     _jobWatcher = new QFutureWatcher<PlayItemInfo>();
     connect(_jobWatcher, &QFutureWatcher<PlayItemInfo>::finished,
             this, &PlaylistModel::onAsyncAppendFinished);
 
+    _thumbnailer = new PlaylistThumbnailer(this);
+    connect(_thumbnailer, &PlaylistThumbnailer::thumbnailReady,
+            this, &PlaylistModel::onThumbnailReady, Qt::QueuedConnection);
+    _thumbnailer->start();
+
+    _journal = new PlaylistJournal(_playlistFile + ".journal", this);
+
     stop();
     loadPlaylist();
+    _journal->start();
 
 #ifndef _LIBDMR_
+    MovieProber::get().setMaxConcurrency(
+        Settings::get().internalOption("probe_concurrency").toInt());
+    PersistentManager::get().setContentHashing(
+        Settings::get().internalOption("cache_verify_hash").toBool());
+    _prefetch = Settings::get().internalOption("gapless_playback").toBool();
+
     if (Settings::get().isSet(Settings::ResumeFromLast)) {
         int restore_pos = Settings::get().internalOption("playlist_pos").toInt();
         _last = restore_pos;
@@ -477,15 +225,16 @@ PlaylistModel::~PlaylistModel()
 {
     qDebug() << __func__;
     delete _jobWatcher;
+    _thumbnailer->stop();
 
 #ifndef _LIBDMR_
     if (Settings::get().isSet(Settings::ClearWhenQuit)) {
-        clearPlaylist();
-    } else {
-        //persistently save current playlist
-        savePlaylist();
+        _journal->reset({});
     }
 #endif
+    // flushes edits still waiting for their batch
+    _journal->stop();
+    delete _store;
 }
 
 qint64 PlaylistModel::getUrlFileTotalSize(QUrl url, int tryTimes) const
@@ -538,38 +287,36 @@ qint64 PlaylistModel::getUrlFileTotalSize(QUrl url, int tryTimes) const
     return size;
 }
 
-void PlaylistModel::clearPlaylist()
+QList<QUrl> PlaylistModel::loadLegacyPlaylist()
 {
-    QSettings cfg(_playlistFile, QSettings::NativeFormat);
-    cfg.beginGroup("playlist");
-    cfg.remove("");
-    cfg.endGroup();
-}
+    QList<QUrl> urls;
 
-void PlaylistModel::savePlaylist()
-{
     QSettings cfg(_playlistFile, QSettings::NativeFormat);
     cfg.beginGroup("playlist");
-    cfg.remove("");
-
-    for (int i = 0; i < count(); ++i) {
-        const auto &pif = _infos[i];
-        cfg.setValue(QString::number(i), pif.url);
-        qDebug() << "save " << pif.url;
+    auto keys = cfg.childKeys();
+    for (int i = 0; i < keys.size(); ++i) {
+        urls.append(cfg.value(QString::number(i)).toUrl());
     }
+    cfg.remove("");
     cfg.endGroup();
-    cfg.sync();
+
+    return urls;
 }
 
 void PlaylistModel::loadPlaylist()
 {
     QList<QUrl> urls;
 
-    QSettings cfg(_playlistFile, QSettings::NativeFormat);
-    cfg.beginGroup("playlist");
-    auto keys = cfg.childKeys();
-    for (int i = 0; i < keys.size(); ++i) {
-        auto url = cfg.value(QString::number(i)).toUrl();
+    if (_journal->exists()) {
+        _restored = _journal->load();
+    } else {
+        _restored = loadLegacyPlaylist();
+        if (_restored.size()) {
+            _journal->reset(_restored);
+        }
+    }
+
+    for (const auto &url : _restored) {
         if (indexOf(url) >= 0) continue;
 
         if (url.isLocalFile()) {
@@ -577,13 +324,13 @@ void PlaylistModel::loadPlaylist()
 
         } else {
             auto pif = calculatePlayInfo(url, QFileInfo());
-            _infos.append(pif);
+            appendItem(pif);
         }
     }
-    cfg.endGroup();
 
     if (urls.size() == 0) {
         _firstLoad = false;
+        finishRestore();
         reshuffle();
         emit countChanged();
         return;
@@ -611,13 +358,13 @@ void PlaylistModel::setPlayMode(PlaylistModel::PlayMode pm)
 
 void PlaylistModel::reshuffle()
 {
-    if (_playMode != PlayMode::ShufflePlay || _infos.size() == 0) {
+    if (_playMode != PlayMode::ShufflePlay || _store->size() == 0) {
         return;
     }
 
     _shufflePlayed = 0;
     _playOrder.clear();
-    for (int i = 0, sz = _infos.size(); i < sz; ++i) {
+    for (int i = 0, sz = _store->size(); i < sz; ++i) {
         _playOrder.append(i);
     }
 
@@ -630,8 +377,13 @@ void PlaylistModel::reshuffle()
 
 void PlaylistModel::clear()
 {
-    _infos.clear();
-    _engine->waitLastEnd();
+    _store->clear();
+    _urlIndex.clear();
+    // running scans start their runs over
+    for (auto &b : _blocks) b.anchor = QUrl();
+    if (!_firstLoad) _journal->clear();
+    _thumbnailer->clear();
+    afterLastEnd(nullptr);
 
     _current = -1;
     _last = -1;
@@ -646,7 +398,11 @@ void PlaylistModel::remove(int pos)
 
     _userRequestingItem = true;
 
-    _infos.removeAt(pos);
+    _thumbnailer->cancel(_store->url(pos));
+    _urlIndex.remove(_store->url(pos));
+    _store->removeAt(pos);
+    if (!_firstLoad) _journal->remove(pos);
+    reindex(pos, _store->size() - 1);
     reshuffle();
 
     _last = _current;
@@ -654,7 +410,7 @@ void PlaylistModel::remove(int pos)
         if (_current == pos) {
             _last = _current;
             _current = -1;
-            _engine->waitLastEnd();
+            afterLastEnd(nullptr);
 
         } else if (pos < _current) {
             _current--;
@@ -664,7 +420,7 @@ void PlaylistModel::remove(int pos)
         if (_current == pos) {
             _last = _current;
             _current = -1;
-            _engine->waitLastEnd();
+            afterLastEnd(nullptr);
         }
     }
 
@@ -679,7 +435,6 @@ void PlaylistModel::remove(int pos)
 
     qDebug() << _last << _current;
     _userRequestingItem = false;
-    savePlaylist();
 }
 
 void PlaylistModel::stop()
@@ -688,14 +443,91 @@ void PlaylistModel::stop()
     emit currentChanged();
 }
 
+void PlaylistModel::afterLastEnd(const std::function<void()> &fn)
+{
+    auto serial = ++_switchSerial;
+    bool requesting = _userRequestingItem;
+    _engine->waitLastEnd([ = ]() {
+        // superseded by a later switch
+        if (serial != _switchSerial) return;
+
+        _switchDone = serial;
+        auto old = _userRequestingItem;
+        _userRequestingItem = requesting;
+        if (fn) fn();
+        _userRequestingItem = old;
+    });
+}
+
+int PlaylistModel::peekNext() const
+{
+    if (_current < 0 || count() == 0) return -1;
+
+    switch (_playMode) {
+    case OrderPlay:
+        return _last + 1 < count() ? _last + 1 : -1;
+
+    case ListLoop:
+        return (_last + 1) % count();
+
+    case ShufflePlay:
+        // a new round gets reshuffled first
+        return _shufflePlayed < _playOrder.size() ? _playOrder[_shufflePlayed] : -1;
+
+    default:
+        // single modes stop or replay, nothing to prefetch
+        return -1;
+    }
+}
+
+void PlaylistModel::queueNext()
+{
+    if (!_prefetch || _engine->state() == PlayerEngine::Idle) return;
+    // the backend is about to stop for another item anyway
+    if (_switchDone != _switchSerial) return;
+
+    int id = peekNext();
+    if (id >= 0 && !_store->isValid(id)) id = -1;
+    _engine->queueNext(id);
+}
+
+void PlaylistModel::advanceToQueued(const QUrl &url)
+{
+    int id = indexOf(url);
+    if (id < 0) {
+        qWarning() << "queued item is not in playlist anymore" << url;
+        return;
+    }
+
+    switch (_playMode) {
+    case ShufflePlay:
+        if (_shufflePlayed < _playOrder.size() && _playOrder[_shufflePlayed] == id)
+            _shufflePlayed++;
+        break;
+
+    case ListLoop:
+        if (id <= _last)
+            _loopCount++;
+        break;
+
+    default:
+        break;
+    }
+
+    _last = _current = id;
+    emit itemInfoUpdated(_current);
+    emit currentChanged();
+}
+
 void PlaylistModel::tryPlayCurrent(bool next)
 {
-    auto &pif = _infos[_current];
-    if (pif.refresh()) {
-        qDebug() << pif.url.fileName() << "changed";
+    if (_current < 0 || _current >= count()) return;
+
+    if (_store->refresh(_current)) {
+        qDebug() << _store->url(_current).fileName() << "changed";
     }
     emit itemInfoUpdated(_current);
-    if (pif.valid) {
+    if (_store->isValid(_current)) {
         _engine->requestPlay(_current);
         emit currentChanged();
     } else {
@@ -720,10 +552,9 @@ void PlaylistModel::playNext(bool fromUser)
             if (_last + 1 >= count()) {
                 _last = -1;
             }
-            _engine->waitLastEnd();
             _current = _last + 1;
             _last = _current;
-            tryPlayCurrent(true);
+            afterLastEnd([ = ] { tryPlayCurrent(true); });
         }
         break;
 
@@ -738,10 +569,9 @@ void PlaylistModel::playNext(bool fromUser)
                 if (_last + 1 >= count()) {
                     _last = -1;
                 }
-                _engine->waitLastEnd();
                 _current = _last + 1;
                 _last = _current;
-                tryPlayCurrent(true);
+                afterLastEnd([ = ] { tryPlayCurrent(true); });
             }
         } else {
             if (_engine->state() == PlayerEngine::Idle) {
@@ -762,9 +592,8 @@ void PlaylistModel::playNext(bool fromUser)
         }
         _shufflePlayed++;
         qDebug() << "shuffle next " << _shufflePlayed - 1;
-        _engine->waitLastEnd();
         _last = _current = _playOrder[_shufflePlayed - 1];
-        tryPlayCurrent(true);
+        afterLastEnd([ = ] { tryPlayCurrent(true); });
         break;
     }
 
@@ -779,9 +608,8 @@ void PlaylistModel::playNext(bool fromUser)
             }
         }
 
-        _engine->waitLastEnd();
         _current = _last;
-        tryPlayCurrent(true);
+        afterLastEnd([ = ] { tryPlayCurrent(true); });
         break;
 
     case ListLoop:
@@ -791,9 +619,8 @@ void PlaylistModel::playNext(bool fromUser)
             _last = 0;
         }
 
-        _engine->waitLastEnd();
         _current = _last;
-        tryPlayCurrent(true);
+        afterLastEnd([ = ] { tryPlayCurrent(true); });
         break;
     }
 
@@ -814,10 +641,9 @@ void PlaylistModel::playPrev(bool fromUser)
             if (_last - 1 < 0) {
                 _last = count();
             }
-            _engine->waitLastEnd();
             _current = _last - 1;
             _last = _current;
-            tryPlayCurrent(false);
+            afterLastEnd([ = ] { tryPlayCurrent(false); });
         }
         break;
 
@@ -832,10 +658,9 @@ void PlaylistModel::playPrev(bool fromUser)
                 if (_last - 1 < 0) {
                     _last = count();
                 }
-                _engine->waitLastEnd();
                 _current = _last - 1;
                 _last = _current;
-                tryPlayCurrent(false);
+                afterLastEnd([ = ] { tryPlayCurrent(false); });
             }
         } else {
             if (_engine->state() == PlayerEngine::Idle) {
@@ -856,9 +681,8 @@ void PlaylistModel::playPrev(bool fromUser)
         }
         _shufflePlayed--;
         qDebug() << "shuffle prev " << _shufflePlayed - 1;
-        _engine->waitLastEnd();
         _last = _current = _playOrder[_shufflePlayed - 1];
-        tryPlayCurrent(false);
+        afterLastEnd([ = ] { tryPlayCurrent(false); });
         break;
     }
 
@@ -868,9 +692,8 @@ void PlaylistModel::playPrev(bool fromUser)
             _last = count() - 1;
         }
 
-        _engine->waitLastEnd();
         _current = _last;
-        tryPlayCurrent(false);
+        afterLastEnd([ = ] { tryPlayCurrent(false); });
         break;
 
     case ListLoop:
@@ -880,9 +703,8 @@ void PlaylistModel::playPrev(bool fromUser)
             _last = count() - 1;
         }
 
-        _engine->waitLastEnd();
         _current = _last;
-        tryPlayCurrent(false);
+        afterLastEnd([ = ] { tryPlayCurrent(false); });
         break;
     }
 
@@ -907,7 +729,7 @@ void PlaylistModel::appendSingle(const QUrl &url)
         if (!fi.exists()) return;
         auto pif = calculatePlayInfo(url, fi);
         if (!pif.valid) return;
-        _infos.append(pif);
+        appendItem(pif);
 
 #ifndef _LIBDMR_
         if (Settings::get().isSet(Settings::AutoSearchSimilar)) {
@@ -917,14 +739,14 @@ void PlaylistModel::appendSingle(const QUrl &url)
                 auto url = QUrl::fromLocalFile(fi.absoluteFilePath());
                 if (indexOf(url) < 0 && _engine->isPlayableFile(fi.fileName())) {
                     auto pif = calculatePlayInfo(url, fi);
-                    if (pif.valid) _infos.append(pif);
+                    if (pif.valid) appendItem(pif);
                 }
             });
         }
 #endif
     } else {
         auto pif = calculatePlayInfo(url, QFileInfo(), true);
-        _infos.append(pif);
+        appendItem(pif);
     }
 }
 
@@ -966,7 +788,9 @@ void PlaylistModel::collectionJob(const QList<QUrl> &urls)
 
 void PlaylistModel::appendAsync(const QList<QUrl> &urls)
 {
+    _delayedAppends++;
     QTimer::singleShot(10, [ = ]() {
+        _delayedAppends--;
         delayedAppendAsync(urls);
     });
 }
@@ -981,7 +805,17 @@ void PlaylistModel::delayedAppendAsync(const QList<QUrl> &urls)
     }
 
     collectionJob(urls);
-    if (!_pendingJob.size()) return;
+    if (!_pendingJob.size()) {
+        // nothing new in this request, requests queued behind it (e.g. the
+        // batches of a directory scan) would otherwise wait for another append
+        QTimer::singleShot(0, this, [ = ]() {
+            if (_pendingJob.isEmpty() && _pendingAppendReq.size()) {
+                delayedAppendAsync(_pendingAppendReq.dequeue());
+            }
+        });
+        checkSortedBlocks();
+        return;
+    }
 
     struct MapFunctor {
         PlaylistModel *_model = 0;
@@ -995,25 +829,27 @@ void PlaylistModel::delayedAppendAsync(const QList<QUrl> &urls)
         };
     };
 
-    if (QThread::idealThreadCount() > 1) {
-        auto future = QtConcurrent::mapped(_pendingJob, MapFunctor(this));
-        _jobWatcher->setFuture(future);
-    } else {
-        PlayItemInfoList pil;
-        for (const auto &a : _pendingJob) {
-            qDebug() << "sync mapping " << a.first.fileName();
-            pil.append(calculatePlayInfo(a.first, a.second));
-        }
-        _pendingJob.clear();
-        _urlsInJob.clear();
-        handleAsyncAppendResults(pil);
+    // probing always happens on the prober's pool, even on single core
+    // machines, so the gui thread never waits for avformat
+    auto future = MovieProber::get().mapped<PlayItemInfo>(_pendingJob, MapFunctor(this));
+    _jobWatcher->setFuture(future);
+}
+
+//sort names by digits inside, take care of such a possible:
+//S01N04, S02N05, S01N12, S02N04, etc...
+static bool FileNameLessThan(const QUrl &url1, const QUrl &url2)
+{
+    QString fileName1 = url1.fileName();
+    QString fileName2 = url2.fileName();
+
+    if (utils::IsNamesSimilar(fileName1, fileName2)) {
+        return utils::CompareNames(fileName1, fileName2);
     }
+    return fileName1.localeAwareCompare(fileName2) < 0;
 }
 
 static QList<PlayItemInfo> &SortSimilarFiles(QList<PlayItemInfo> &fil)
 {
-    //sort names by digits inside, take care of such a possible:
-    //S01N04, S02N05, S01N12, S02N04, etc...
     struct {
         bool operator()(const PlayItemInfo &fi1, const PlayItemInfo &fi2) const
         {
@@ -1022,13 +858,7 @@ static QList<PlayItemInfo> &SortSimilarFiles(QList<PlayItemInfo> &fil)
             if (!fi2.valid)
                 return false;
 
-            QString fileName1 = fi1.url.fileName();
-            QString fileName2 = fi2.url.fileName();
-
-            if (utils::IsNamesSimilar(fileName1, fileName2)) {
-                return utils::CompareNames(fileName1, fileName2);
-            }
-            return fileName1.localeAwareCompare(fileName2) < 0;
+            return FileNameLessThan(fi1.url, fi2.url);
         }
     } SortByDigits;
     std::sort(fil.begin(), fil.end(), SortByDigits);
@@ -1050,8 +880,9 @@ void PlaylistModel::onAsyncAppendFinished()
 void PlaylistModel::handleAsyncAppendResults(QList<PlayItemInfo> &fil)
 {
     qDebug() << __func__ << fil.size();
+    bool restoring = _firstLoad;
     if (!_firstLoad) {
-        //since _infos are modified only at the same thread, the lock is not necessary
+        //since _store is modified only at the same thread, the lock is not necessary
         auto last = std::remove_if(fil.begin(), fil.end(), [](const PlayItemInfo & pif) {
             return !pif.mi.valid;
         });
@@ -1060,17 +891,42 @@ void PlaylistModel::handleAsyncAppendResults(QList<PlayItemInfo> &fil)
 
     qDebug() << "collected items" << fil.count();
     if (fil.size()) {
-        if (!_firstLoad)
-            _infos += SortSimilarFiles(fil);
-        else
-            _infos += fil;
+        int current = _current;
+        QList<PlayItemInfo> rest;
+        if (!_firstLoad) {
+            SortSimilarFiles(fil);
+
+            // files of a scanned folder go into the folder's run, in
+            // place, so batches of one scan end up sorted as a whole
+            QVector<QList<PlayItemInfo>> blocks(_blocks.size());
+            for (const auto &pif : fil) {
+                int b = sortedBlockOf(pif.url);
+                if (b >= 0) blocks[b].append(pif);
+                else rest.append(pif);
+            }
+            for (int b = 0; b < blocks.size(); b++) {
+                if (blocks[b].size()) insertSorted(_blocks[b], blocks[b]);
+            }
+        } else {
+            rest = fil;
+        }
+
+        for (const auto &pif : rest) {
+            appendItem(pif);
+        }
         reshuffle();
         _firstLoad = false;
         emit itemsAppended();
         emit countChanged();
+        if (_current != current)
+            emit currentChanged();
+        QList<QUrl> added;
+        for (const auto &pif : fil) added.append(pif.url);
+        queueThumbnails(added);
     }
     _firstLoad = false;
     emit asyncAppendFinished(fil);
+    checkSortedBlocks();
 
     QTimer::singleShot(0, [&]() {
         if (_pendingAppendReq.size()) {
@@ -1078,7 +934,10 @@ void PlaylistModel::handleAsyncAppendResults(QList<PlayItemInfo> &fil)
             delayedAppendAsync(job);
         }
     });
-    savePlaylist();
+
+    if (restoring) {
+        finishRestore();
+    }
 }
 
 bool PlaylistModel::hasPendingAppends()
@@ -1091,10 +950,60 @@ void PlaylistModel::append(const QUrl &url)
 {
     if (!url.isValid()) return;
 
+    auto from = _store->size();
     appendSingle(url);
     reshuffle();
     emit itemsAppended();
     emit countChanged();
+
+    QList<QUrl> added;
+    for (int i = from; i < _store->size(); i++) added.append(_store->url(i));
+    queueThumbnails(added);
+}
+
+void PlaylistModel::queueThumbnails(const QList<QUrl> &urls)
+{
+    QList<QPair<QUrl, QFileInfo>> jobs;
+    for (const auto &url : urls) {
+        int i = indexOf(url);
+        if (i >= 0 && _store->isValid(i) && _store->isLoaded(i) && url.isLocalFile() && !_store->hasThumbnail(i)) {
+            jobs.append(qMakePair(url, QFileInfo(url.toLocalFile())));
+        }
+    }
+
+    if (jobs.size()) {
+        _thumbnailer->enqueue(jobs);
+    }
+}
+
+void PlaylistModel::requestThumbnails(const QList<int> &ids)
+{
+    QList<QUrl> urls;
+    for (auto id : ids) {
+        if (id < 0 || id >= _store->size() || !_store->thumbnail(id).isNull()) continue;
+
+        // missing or evicted from the cache, the thumbnailer reloads it
+        // from the persistent store or generates it again
+        const auto &url = _store->url(id);
+        if (_store->isValid(id) && _store->isLoaded(id) && url.isLocalFile()) {
+            urls.append(url);
+        }
+    }
+
+    if (urls.size()) {
+        _thumbnailer->prioritize(urls);
+    }
+}
+
+void PlaylistModel::onThumbnailReady(const QUrl &url, const QImage &img)
+{
+    auto id = indexOf(url);
+    if (id < 0 || img.isNull()) return;
+
+    auto pm = QPixmap::fromImage(img);
+    pm.setDevicePixelRatio(qApp->devicePixelRatio());
+    _store->setThumbnail(id, pm);
+    emit itemInfoUpdated(id);
 }
 
 void PlaylistModel::changeCurrent(int pos)
@@ -1103,10 +1012,9 @@ void PlaylistModel::changeCurrent(int pos)
 
     _userRequestingItem = true;
 
-    _engine->waitLastEnd();
     _current = pos;
     _last = _current;
-    tryPlayCurrent(true);
+    afterLastEnd([ = ] { tryPlayCurrent(true); });
     _userRequestingItem = false;
     emit currentChanged();
 }
@@ -1114,11 +1022,13 @@ void PlaylistModel::changeCurrent(int pos)
 void PlaylistModel::switchPosition(int src, int target)
 {
     //Q_ASSERT_X(0, "playlist", "not implemented");
-    Q_ASSERT (src < _infos.size() && target < _infos.size());
-    _infos.move(src, target);
+    Q_ASSERT (src < _store->size() && target < _store->size());
+    _store->move(src, target);
+    if (!_firstLoad) _journal->move(src, target);
 
     int min = qMin(src, target);
     int max = qMax(src, target);
+    reindex(min, max);
     if (_current >= min && _current <= max) {
         if (_current == src) {
             _current = target;
@@ -1134,29 +1044,24 @@ void PlaylistModel::switchPosition(int src, int target)
         }
         emit currentChanged();
     }
+    queueNext();
 }
 
-PlayItemInfo &PlaylistModel::currentInfo()
+PlayItemInfo PlaylistModel::currentInfo() const
 {
-    //Q_ASSERT (_infos.size() > 0 && _current >= 0);
-    Q_ASSERT (_infos.size() > 0);
+    //Q_ASSERT (_store->size() > 0 && _current >= 0);
+    Q_ASSERT (_store->size() > 0);
 
     if (_current >= 0)
-        return _infos[_current];
+        return _store->at(_current);
     if (_last >= 0)
-        return _infos[_last];
-    return _infos[0];
-}
-
-const PlayItemInfo &PlaylistModel::currentInfo() const
-{
-    Q_ASSERT (_infos.size() > 0 && _current >= 0);
-    return _infos[_current];
+        return _store->at(_last);
+    return _store->at(0);
 }
 
 int PlaylistModel::count() const
 {
-    return _infos.count();
+    return _store->count();
 }
 
 int PlaylistModel::current() const
@@ -1197,25 +1102,16 @@ struct PlayItemInfo PlaylistModel::calculatePlayInfo(const QUrl &url, const QFil
         }
     }
 
+    // thumbnail is not generated here, see queueThumbnails
     QPixmap pm;
     if (ci.thumb_valid) {
-        pm = ci.thumb;
+        pm = QPixmap::fromImage(ci.thumb);
+        pm.setDevicePixelRatio(qApp->devicePixelRatio());
         qDebug() << "load cached thumb" << url;
-    } else if (ok) {
-        try {
-            std::vector<uint8_t> buf;
-            _thumbnailer.generateThumbnail(fi.canonicalFilePath().toUtf8().toStdString(),
-                                           ThumbnailerImageType::Png, buf);
-
-            auto img = QImage::fromData(buf.data(), buf.size(), "png");
-            pm = QPixmap::fromImage(img);
-            pm.setDevicePixelRatio(qApp->devicePixelRatio());
-        } catch (const std::logic_error &) {
-        }
     }
 
     PlayItemInfo pif { fi.exists() || !url.isLocalFile(), ok, url, fi, pm, mi };
-    if (ok && url.isLocalFile() && (!ci.mi_valid || !ci.thumb_valid)) {
+    if (ok && url.isLocalFile() && !ci.mi_valid) {
         PersistentManager::get().save(pif);
     }
     if (!url.isLocalFile() && !url.scheme().startsWith("dvd")) {
@@ -1236,17 +1132,173 @@ struct PlayItemInfo PlaylistModel::calculatePlayInfo(const QUrl &url, const QFil
     return pif;
 }
 
-int PlaylistModel::indexOf(const QUrl &url)
+int PlaylistModel::indexOf(const QUrl &url) const
 {
-    auto p = std::find_if(_infos.begin(), _infos.end(), [&](const PlayItemInfo & pif) {
-        return pif.url == url;
-    });
+    return _urlIndex.value(url, -1);
+}
+
+bool PlaylistModel::appendItem(const PlayItemInfo &pif)
+{
+    if (_urlIndex.contains(pif.url)) return false;
+
+    _urlIndex.insert(pif.url, _store->size());
+    _store->append(pif);
+    if (!_firstLoad) _journal->append(pif.url);
+    return true;
+}
+
+bool PlaylistModel::insertItem(int pos, const PlayItemInfo &pif)
+{
+    if (_urlIndex.contains(pif.url)) return false;
+
+    _store->insert(pos, pif);
+    reindex(pos, _store->size() - 1);
+    if (!_firstLoad) {
+        _journal->append(pif.url);
+        _journal->move(_store->size() - 1, pos);
+    }
+
+    if (_current >= pos) _current++;
+    if (_last >= pos) _last++;
+    emit itemInserted(pos);
+    return true;
+}
+
+static bool UnderPrefix(const QUrl &url, const QString &prefix)
+{
+    return url.isLocalFile() && url.toLocalFile().startsWith(prefix);
+}
+
+void PlaylistModel::beginSortedBlock(const QString &root)
+{
+    for (auto &b : _blocks) {
+        if (b.root == root) {
+            b.scans++;
+            return;
+        }
+    }
+
+    SortedBlock b;
+    b.root = root;
+    b.prefix = root.endsWith('/') ? root : root + '/';
+    _blocks.append(b);
+}
+
+void PlaylistModel::endSortedBlock(const QString &root)
+{
+    for (auto &b : _blocks) {
+        if (b.root == root) {
+            b.scans--;
+            checkSortedBlocks();
+            return;
+        }
+    }
+
+    qWarning() << __func__ << "no block for" << root;
+    emit sortedBlockFinished(root, QUrl());
+}
+
+bool PlaylistModel::inSortedBlock(const QUrl &url) const
+{
+    return sortedBlockOf(url) >= 0;
+}
+
+int PlaylistModel::sortedBlockOf(const QUrl &url) const
+{
+    for (int i = 0; i < _blocks.size(); i++) {
+        if (UnderPrefix(url, _blocks[i].prefix)) return i;
+    }
+    return -1;
+}
 
-    if (p == _infos.end()) return -1;
-    return std::distance(_infos.begin(), p);
+void PlaylistModel::insertSorted(SortedBlock &b, const QList<PlayItemInfo> &pil)
+{
+    int lo = _store->size(), hi = lo;
+    int at = b.anchor.isValid() ? indexOf(b.anchor) : -1;
+    if (at >= 0) {
+        // the run is found around its anchor, edits may have moved it
+        lo = at;
+        hi = at + 1;
+        while (lo > 0 && UnderPrefix(_store->url(lo - 1), b.prefix)) lo--;
+        while (hi < _store->size() && UnderPrefix(_store->url(hi), b.prefix)) hi++;
+    }
+
+    // pil is sorted too, each one goes after the one before it
+    for (const auto &pif : pil) {
+        int l = lo, r = hi;
+        while (l < r) {
+            int mid = (l + r) / 2;
+            if (FileNameLessThan(pif.url, _store->url(mid))) r = mid;
+            else l = mid + 1;
+        }
+
+        if (insertItem(l, pif)) {
+            b.anchor = pif.url;
+            lo = l + 1;
+            hi++;
+        }
+    }
+}
+
+void PlaylistModel::checkSortedBlocks()
+{
+    // a batch may still sit on its appendAsync() timer
+    if (_delayedAppends > 0) return;
+
+    for (int i = 0; i < _blocks.size();) {
+        const auto &b = _blocks[i];
+        bool waiting = b.scans > 0;
+        for (int j = 0; !waiting && j < _pendingJob.size(); j++) {
+            waiting = UnderPrefix(_pendingJob[j].first, b.prefix);
+        }
+        // scan batches come from one folder, their first url tells
+        for (int j = 0; !waiting && j < _pendingAppendReq.size(); j++) {
+            const auto &req = _pendingAppendReq[j];
+            waiting = req.size() && UnderPrefix(req[0], b.prefix);
+        }
+        if (waiting) {
+            i++;
+            continue;
+        }
+
+        auto block = _blocks.takeAt(i);
+        QUrl first;
+        int at = block.anchor.isValid() ? indexOf(block.anchor) : -1;
+        if (at >= 0) {
+            while (at > 0 && UnderPrefix(_store->url(at - 1), block.prefix)) at--;
+            first = _store->url(at);
+        }
+        qDebug() << "sorted block done" << block.root << first;
+        emit sortedBlockFinished(block.root, first);
+    }
+}
+
+void PlaylistModel::finishRestore()
+{
+    bool same = _restored.size() == _store->size();
+    for (int i = 0; same && i < _store->size(); i++) {
+        same = _restored[i] == _store->url(i);
+    }
+
+    // dropped duplicates, missing files, reordering or edits made while loading
+    if (!same) {
+        QList<QUrl> urls;
+        urls.reserve(_store->size());
+        for (int i = 0; i < _store->size(); i++) {
+            urls.append(_store->url(i));
+        }
+        _journal->reset(urls);
+    }
+    _restored.clear();
+}
+
+void PlaylistModel::reindex(int from, int to)
+{
+    for (int i = qMax(from, 0); i <= to && i < _store->size(); i++) {
+        _urlIndex[_store->url(i)] = i;
+    }
 }
 
 }
 
-#include "playlist_model.moc"
 
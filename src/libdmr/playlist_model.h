@@ -32,13 +32,15 @@
 
 #include <QtWidgets>
 #include <QtConcurrent>
-#include <libffmpegthumbnailer/videothumbnailer.h>
+#include <functional>
 
 #include "utils.h"
 #include <QNetworkReply>
 namespace dmr {
-using namespace ffmpegthumbnailer;
 class PlayerEngine;
+class PlaylistThumbnailer;
+class PlaylistStore;
+class PlaylistJournal;
 
 struct MovieInfo {
     bool valid;
@@ -106,6 +108,9 @@ struct MovieInfo {
 };
 
 
+QDataStream &operator<< (QDataStream &st, const MovieInfo &mi);
+QDataStream &operator>> (QDataStream &st, MovieInfo &mi);
+
 struct PlayItemInfo {
     bool valid;
     bool loaded;  // if url is network, this is false until playback started
@@ -158,39 +163,54 @@ public:
     void playPrev(bool fromUser);
 
     int count() const;
-    const QList<PlayItemInfo> &items() const
-    {
-        return _infos;
-    }
-    QList<PlayItemInfo> &items()
+    // read in place, see playlist_store.h
+    const PlaylistStore &items() const
     {
-        return _infos;
+        return *_store;
     }
 
     int current() const;
-    const PlayItemInfo &currentInfo() const;
-    PlayItemInfo &currentInfo();
-    int indexOf(const QUrl &url);
+    // put together from the store, not a reference into it
+    PlayItemInfo currentInfo() const;
+    int indexOf(const QUrl &url) const;
 
     void switchPosition(int p1, int p2);
 
     bool hasPendingAppends();
 
+    // thumbnails are generated after items get appended, ids in the
+    // list (e.g visible rows) are served before others
+    void requestThumbnails(const QList<int> &ids);
+
+    // files from under root that get appended until endSortedBlock() are
+    // kept in one run sorted by name, as if they came in a single append
+    void beginSortedBlock(const QString &root);
+    // nothing more will come for root, sortedBlockFinished() follows once
+    // the appends still on their way are done
+    void endSortedBlock(const QString &root);
+    // url falls under a block that is not finished yet
+    bool inSortedBlock(const QUrl &url) const;
+
 public slots:
     void changeCurrent(int);
 
 private slots:
     void onAsyncAppendFinished();
     void delayedAppendAsync(const QList<QUrl> &);
+    void onThumbnailReady(const QUrl &url, const QImage &img);
 
 signals:
     void countChanged();
     void currentChanged();
     void itemRemoved(int);
+    // a single item went in at pos, the ones from pos on moved down
+    void itemInserted(int pos);
     void itemsAppended();
     void emptied();
     void playModeChanged(PlayMode);
     void asyncAppendFinished(const QList<PlayItemInfo> &);
+    // first is the first item of the block, empty if none made it in
+    void sortedBlockFinished(const QString &root, const QUrl &first);
     void itemInfoUpdated(int id);
 
 private:
@@ -200,7 +220,9 @@ private:
     int _current {-1};
     int _last {-1};
     PlayMode _playMode {PlayMode::OrderPlay};
-    QList<PlayItemInfo> _infos;
+    PlaylistStore *_store {nullptr};
+    // position of every url in _store, urls are unique in the list
+    QHash<QUrl, int> _urlIndex;
 
     QList<int> _playOrder; // for shuffle mode
     int _shufflePlayed {0}; // count currently played items in shuffle mode
@@ -211,22 +233,64 @@ private:
     QFutureWatcher<PlayItemInfo> *_jobWatcher {nullptr};
 
     QQueue<UrlList> _pendingAppendReq;
+    // appendAsync() calls whose request is not queued yet
+    int _delayedAppends {0};
+
+    struct SortedBlock {
+        QString root;
+        QString prefix;     // root with a trailing '/'
+        QUrl anchor;        // any item of the run, empty before the first
+        int scans {1};      // begun and not yet ended
+    };
+    QList<SortedBlock> _blocks;
+
+    // queue the upcoming item into the backend for gapless transitions
+    bool _prefetch {true};
 
     bool _userRequestingItem {false};
+    // afterLastEnd requests issued / completed
+    int _switchSerial {0};
+    int _switchDone {0};
 
-    VideoThumbnailer _thumbnailer;
+    PlaylistThumbnailer *_thumbnailer {nullptr};
     PlayerEngine *_engine {nullptr};
 
     QString _playlistFile;
+    // edits are journaled only once the restored list is in place
+    PlaylistJournal *_journal {nullptr};
+    // urls the journal held at startup, until the first load finishes
+    QList<QUrl> _restored;
 
     struct PlayItemInfo calculatePlayInfo(const QUrl &, const QFileInfo &fi, bool isDvd = false);
     void reshuffle();
-    void savePlaylist();
     void loadPlaylist();
-    void clearPlaylist();
+    // the QSettings based playlist of older versions, removed once read
+    QList<QUrl> loadLegacyPlaylist();
+    // resyncs the journal if the restored list came out different
+    void finishRestore();
     void appendSingle(const QUrl &);
+    // appends unless url is listed already, returns whether it did
+    bool appendItem(const PlayItemInfo &pif);
+    // same for position pos, emits itemInserted
+    bool insertItem(int pos, const PlayItemInfo &pif);
+    // places pil, sorted by name, into the run of block b
+    void insertSorted(SortedBlock &b, const QList<PlayItemInfo> &pil);
+    int sortedBlockOf(const QUrl &url) const;
+    // reports ended blocks that have no appends left on their way
+    void checkSortedBlocks();
+    // refreshes _urlIndex for positions from..to of _store
+    void reindex(int from, int to);
     void tryPlayCurrent(bool next);
+    // stops the engine without blocking, fn runs once the last playback
+    // has ended unless another switch was requested meanwhile
+    void afterLastEnd(const std::function<void()> &fn);
+    // item playNext(false) would pick, without moving there
+    int peekNext() const;
+    void queueNext();
+    // backend moved on to the queued item by itself
+    void advanceToQueued(const QUrl &url);
     void handleAsyncAppendResults(QList<PlayItemInfo> &pil);
+    void queueThumbnails(const QList<QUrl> &urls);
 };
 
 }
@@ -0,0 +1,243 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "playlist_store.h"
+
+namespace dmr {
+
+// enough for the rows of a few playlist screens
+static const int THUMB_CACHE_BUDGET = 16 << 20;
+
+PlaylistStore::PlaylistStore()
+{
+    _strings.append(QString());
+    _thumbs.setMaxCost(THUMB_CACHE_BUDGET);
+}
+
+quint32 PlaylistStore::intern(const QString &s)
+{
+    if (s.isEmpty()) return 0;
+
+    auto p = _stringIds.constFind(s);
+    if (p != _stringIds.cend()) return *p;
+
+    quint32 id = _strings.size();
+    _strings.append(s);
+    _stringIds.insert(s, id);
+    return id;
+}
+
+void PlaylistStore::pack(const PlayItemInfo &pif, Row *row, Streams *st)
+{
+    const auto &mi = pif.mi;
+
+    quint16 flags = row->flags & HasThumb;
+    if (pif.valid) flags |= Valid;
+    if (pif.loaded) flags |= Loaded;
+    if (mi.valid) flags |= InfoValid;
+
+    if (mi.title == pif.url.fileName()) {
+        flags |= TitleFromUrl;
+        row->title = 0;
+    } else {
+        row->title = intern(mi.title);
+    }
+    if (pif.url.isLocalFile() && mi.filePath == pif.url.toLocalFile()) {
+        flags |= PathFromUrl;
+        row->filePath = 0;
+    } else {
+        row->filePath = intern(mi.filePath);
+    }
+
+    row->duration = mi.duration;
+    row->fileSize = mi.fileSize;
+    row->width = mi.width;
+    row->height = mi.height;
+    row->fileType = intern(mi.fileType);
+    row->resolution = intern(mi.resolution);
+    row->creation = intern(mi.creation);
+    row->rawRotate = mi.raw_rotate;
+    row->flags = flags;
+
+    st->vCodeRate = mi.vCodeRate;
+    st->aCodeRate = mi.aCodeRate;
+    st->proportion = mi.proportion;
+    st->vCodecID = mi.vCodecID;
+    st->fps = mi.fps;
+    st->aCodeID = mi.aCodeID;
+    st->aDigit = mi.aDigit;
+    st->channels = mi.channels;
+    st->sampling = mi.sampling;
+}
+
+void PlaylistStore::append(const PlayItemInfo &pif)
+{
+    insert(_urls.size(), pif);
+}
+
+void PlaylistStore::insert(int i, const PlayItemInfo &pif)
+{
+    Row row;
+    Streams st;
+    pack(pif, &row, &st);
+
+    _urls.insert(i, pif.url);
+    _rows.insert(i, row);
+    _streams.insert(i, st);
+
+    if (!pif.thumbnail.isNull()) {
+        setThumbnail(i, pif.thumbnail);
+    }
+}
+
+void PlaylistStore::update(int i, const PlayItemInfo &pif)
+{
+    pack(pif, &_rows[i], &_streams[i]);
+    if (!pif.thumbnail.isNull()) {
+        setThumbnail(i, pif.thumbnail);
+    }
+}
+
+void PlaylistStore::removeAt(int i)
+{
+    _thumbs.remove(_urls[i]);
+    _urls.removeAt(i);
+    _rows.removeAt(i);
+    _streams.removeAt(i);
+}
+
+void PlaylistStore::move(int from, int to)
+{
+    if (from == to) return;
+
+    auto url = _urls.takeAt(from);
+    auto row = _rows.takeAt(from);
+    auto st = _streams.takeAt(from);
+    _urls.insert(to, url);
+    _rows.insert(to, row);
+    _streams.insert(to, st);
+}
+
+void PlaylistStore::clear()
+{
+    _urls.clear();
+    _rows.clear();
+    _streams.clear();
+    _strings.resize(1);
+    _stringIds.clear();
+    _thumbs.clear();
+}
+
+QString PlaylistStore::title(int i) const
+{
+    const auto &row = _rows[i];
+    return (row.flags & TitleFromUrl) ? _urls[i].fileName() : _strings[row.title];
+}
+
+struct MovieInfo PlaylistStore::movieInfo(int i) const
+{
+    const auto &row = _rows[i];
+    const auto &st = _streams[i];
+
+    struct MovieInfo mi;
+    mi.valid = row.flags & InfoValid;
+    mi.title = title(i);
+    mi.fileType = _strings[row.fileType];
+    mi.resolution = _strings[row.resolution];
+    mi.filePath = (row.flags & PathFromUrl) ? _urls[i].toLocalFile() : _strings[row.filePath];
+    mi.creation = _strings[row.creation];
+    mi.raw_rotate = row.rawRotate;
+    mi.fileSize = row.fileSize;
+    mi.duration = row.duration;
+    mi.width = row.width;
+    mi.height = row.height;
+    mi.vCodecID = st.vCodecID;
+    mi.vCodeRate = st.vCodeRate;
+    mi.fps = st.fps;
+    mi.proportion = st.proportion;
+    mi.aCodeID = st.aCodeID;
+    mi.aCodeRate = st.aCodeRate;
+    mi.aDigit = st.aDigit;
+    mi.channels = st.channels;
+    mi.sampling = st.sampling;
+    return mi;
+}
+
+PlayItemInfo PlaylistStore::at(int i) const
+{
+    const auto &url = _urls[i];
+    return PlayItemInfo {
+        isValid(i), isLoaded(i), url,
+        url.isLocalFile() ? QFileInfo(url.toLocalFile()) : QFileInfo(),
+        thumbnail(i), movieInfo(i)
+    };
+}
+
+QPixmap PlaylistStore::thumbnail(int i) const
+{
+    if (!(_rows[i].flags & HasThumb)) return QPixmap();
+
+    // views call this while painting, an evicted one is not decoded here
+    auto *pm = _thumbs.object(_urls[i]);
+    return pm ? *pm : QPixmap();
+}
+
+void PlaylistStore::setThumbnail(int i, const QPixmap &pm)
+{
+    if (pm.isNull()) {
+        _rows[i].flags &= ~HasThumb;
+        _thumbs.remove(_urls[i]);
+        return;
+    }
+
+    _rows[i].flags |= HasThumb;
+    _thumbs.insert(_urls[i], new QPixmap(pm), qMax(1, pm.width() * pm.height() * pm.depth() / 8));
+}
+
+void PlaylistStore::setThumbnailBudget(int bytes)
+{
+    _thumbs.setMaxCost(bytes);
+}
+
+bool PlaylistStore::refresh(int i)
+{
+    const auto &url = _urls[i];
+    if (!url.isLocalFile()) return false;
+
+    auto &row = _rows[i];
+    QFileInfo fi(url.toLocalFile());
+    bool exists = fi.exists();
+    bool changed = exists != bool(row.flags & Valid) || (exists && fi.size() != row.fileSize);
+
+    if (exists) row.flags |= Valid;
+    else row.flags &= ~Valid;
+    return changed;
+}
+
+}
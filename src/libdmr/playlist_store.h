@@ -0,0 +1,142 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_PLAYLIST_STORE_H
+#define _DMR_PLAYLIST_STORE_H
+
+#include <QtGui>
+
+#include "playlist_model.h"
+
+namespace dmr {
+
+/*
+   class PlaylistStore
+   columnar storage behind PlaylistModel. per item it keeps the url, a
+   packed row of the fields views read all the time (duration, size,
+   flags, ids of interned strings) and the stream details in a column of
+   their own. titles and paths equal to what the url gives are not stored
+   at all. thumbnails are not owned by items: a row only records that one
+   exists, pixmaps live in a bounded cache. once evicted they are gone
+   here, PlaylistModel::requestThumbnails has them reloaded in background.
+   PlayItemInfo is put together on request, use the column getters where
+   a field or two is enough.
+   gui thread only.
+*/
+class PlaylistStore
+{
+public:
+    PlaylistStore();
+
+    int size() const { return _urls.size(); }
+    int count() const { return _urls.size(); }
+    bool isEmpty() const { return _urls.isEmpty(); }
+
+    void append(const PlayItemInfo &pif);
+    void insert(int i, const PlayItemInfo &pif);
+    // everything but the url is replaced
+    void update(int i, const PlayItemInfo &pif);
+    void removeAt(int i);
+    void move(int from, int to);
+    void clear();
+
+    PlayItemInfo at(int i) const;
+    PlayItemInfo operator[](int i) const { return at(i); }
+
+    const QUrl &url(int i) const { return _urls[i]; }
+    bool isValid(int i) const { return _rows[i].flags & Valid; }
+    bool isLoaded(int i) const { return _rows[i].flags & Loaded; }
+    qint64 duration(int i) const { return _rows[i].duration; }
+    QString title(int i) const;
+    struct MovieInfo movieInfo(int i) const;
+
+    bool hasThumbnail(int i) const { return _rows[i].flags & HasThumb; }
+    // cached pixmap, null if the item has none or it was evicted
+    QPixmap thumbnail(int i) const;
+    void setThumbnail(int i, const QPixmap &pm);
+    // budget of the thumbnail cache in bytes
+    void setThumbnailBudget(int bytes);
+
+    // checks the file again, true if it appeared, vanished or changed size
+    bool refresh(int i);
+
+private:
+    enum Flag {
+        Valid = 0x01,
+        Loaded = 0x02,
+        InfoValid = 0x04,       // MovieInfo::valid
+        HasThumb = 0x08,
+        TitleFromUrl = 0x10,    // title is url.fileName()
+        PathFromUrl = 0x20,     // filePath is url.toLocalFile()
+    };
+
+    struct Row {
+        qint64 duration {0};
+        qint64 fileSize {0};
+        qint32 width {0};
+        qint32 height {0};
+        quint32 title {0};
+        quint32 filePath {0};
+        quint32 fileType {0};
+        quint32 resolution {0};
+        quint32 creation {0};
+        qint16 rawRotate {0};
+        quint16 flags {0};
+    };
+
+    struct Streams {
+        qint64 vCodeRate {0};
+        qint64 aCodeRate {0};
+        float proportion {0};
+        qint32 vCodecID {0};
+        qint32 fps {0};
+        qint32 aCodeID {0};
+        qint32 aDigit {0};
+        qint32 channels {0};
+        qint32 sampling {0};
+    };
+
+    QVector<QUrl> _urls;
+    QVector<Row> _rows;
+    QVector<Streams> _streams;
+
+    // strings are never dropped before clear(), id 0 is the empty string
+    QVector<QString> _strings;
+    QHash<QString, quint32> _stringIds;
+
+    mutable QCache<QUrl, QPixmap> _thumbs;
+
+    quint32 intern(const QString &s);
+    void pack(const PlayItemInfo &pif, Row *row, Streams *st);
+};
+
+}
+
+#endif /* ifndef _DMR_PLAYLIST_STORE_H */
+
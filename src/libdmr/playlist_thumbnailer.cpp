@@ -0,0 +1,159 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#include "playlist_thumbnailer.h"
+#include "persistent_manager.h"
+
+namespace dmr {
+
+PlaylistThumbnailer::PlaylistThumbnailer(QObject *parent)
+    : QThread(parent)
+{
+    _thumbSize = 400 * qApp->devicePixelRatio();
+    _grabber.setCancelFlag(&_quit);
+}
+
+PlaylistThumbnailer::~PlaylistThumbnailer()
+{
+    stop();
+}
+
+void PlaylistThumbnailer::enqueue(const QList<QPair<QUrl, QFileInfo>> &jobs)
+{
+    QMutexLocker lock(&_lock);
+    for (const auto &job : jobs) {
+        if (!_jobs.contains(job.first)) {
+            _queue.append(job.first);
+        }
+        _jobs.insert(job.first, job.second);
+    }
+    _cond.wakeOne();
+}
+
+void PlaylistThumbnailer::prioritize(const QList<QUrl> &urls)
+{
+    QMutexLocker lock(&_lock);
+    for (auto p = urls.rbegin(); p != urls.rend(); ++p) {
+        if (_queue.removeOne(*p)) {
+            _queue.prepend(*p);
+        } else if (p->isLocalFile() && *p != _running) {
+            _jobs.insert(*p, QFileInfo(p->toLocalFile()));
+            _queue.prepend(*p);
+        }
+    }
+    _cond.wakeOne();
+}
+
+void PlaylistThumbnailer::cancel(const QUrl &url)
+{
+    QMutexLocker lock(&_lock);
+    _queue.removeOne(url);
+    _jobs.remove(url);
+}
+
+void PlaylistThumbnailer::clear()
+{
+    QMutexLocker lock(&_lock);
+    _queue.clear();
+    _jobs.clear();
+}
+
+void PlaylistThumbnailer::stop()
+{
+    if (!isRunning()) return;
+
+    {
+        QMutexLocker lock(&_lock);
+        _quit.store(1);
+        _cond.wakeAll();
+    }
+    wait();
+}
+
+QImage PlaylistThumbnailer::genThumb(const QUrl &url, const QFileInfo &fi)
+{
+    // evicted from the playlist's cache but still on disk
+    auto cached = PersistentManager::get().loadThumbnail(url);
+    if (!cached.isNull()) {
+        return cached;
+    }
+
+    if (!_grabber.open(fi.canonicalFilePath())) {
+        return QImage();
+    }
+
+    // 10% into the movie, where ffmpegthumbnailer used to pick its frame
+    auto ms = _grabber.nearestKeyframe(_grabber.duration() / 10);
+    auto img = _grabber.grab(ms, QSize(_thumbSize, _thumbSize));
+    _grabber.close();
+
+    if (!img.isNull()) {
+        // only the cache needs it encoded, the item gets img as is
+        QByteArray data;
+        QBuffer buf(&data);
+        buf.open(QIODevice::WriteOnly);
+        img.save(&buf, "png");
+        PersistentManager::get().saveThumbnail(url, data);
+    }
+
+    return img;
+}
+
+void PlaylistThumbnailer::run()
+{
+    setPriority(QThread::IdlePriority);
+
+    while (!_quit.load()) {
+        QUrl url;
+        QFileInfo fi;
+        {
+            QMutexLocker lock(&_lock);
+            while (_queue.isEmpty() && !_quit.load()) {
+                _cond.wait(&_lock);
+            }
+
+            if (_quit.load()) break;
+
+            url = _queue.takeFirst();
+            fi = _jobs.take(url);
+            _running = url;
+        }
+
+        auto img = genThumb(url, fi);
+        {
+            QMutexLocker lock(&_lock);
+            _running = QUrl();
+        }
+        if (!_quit.load()) {
+            emit thumbnailReady(url, img);
+        }
+    }
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+#ifndef _DMR_PLAYLIST_THUMBNAILER_H
+#define _DMR_PLAYLIST_THUMBNAILER_H
+
+#include <QtGui>
+
+#include "frame_grabber.h"
+
+namespace dmr {
+
+/*
+   class PlaylistThumbnailer
+   second phase of playlist import: items are appended as soon as their
+   metadata is known, thumbnails are generated afterwards by this worker.
+   requests are served in priority order, rows visible in the playlist
+   are pushed to the front of the queue.
+*/
+class PlaylistThumbnailer: public QThread
+{
+    Q_OBJECT
+public:
+    PlaylistThumbnailer(QObject *parent = nullptr);
+    ~PlaylistThumbnailer();
+
+    // queued at the back, in order
+    void enqueue(const QList<QPair<QUrl, QFileInfo>> &jobs);
+    // moved to the front, keeping the order of urls. local files that
+    // are not queued (never were, or got cancelled) are queued there
+    void prioritize(const QList<QUrl> &urls);
+    void cancel(const QUrl &url);
+    void clear();
+
+    void stop();
+
+signals:
+    // emitted from the worker thread, image is null if generation failed
+    void thumbnailReady(const QUrl &url, const QImage &img);
+
+protected:
+    void run() override;
+
+private:
+    QMutex _lock;
+    QWaitCondition _cond;
+    QList<QUrl> _queue;
+    QHash<QUrl, QFileInfo> _jobs;
+    // being generated right now, not queued again
+    QUrl _running;
+    QAtomicInt _quit {0};
+    FrameGrabber _grabber;
+    int _thumbSize;
+
+    QImage genThumb(const QUrl &url, const QFileInfo &fi);
+};
+
+}
+
+#endif /* ifndef _DMR_PLAYLIST_THUMBNAILER_H */
@@ -0,0 +1,624 @@
+/*
+ * (c) 2017, Deepin Technology Co., Ltd. <support@deepin.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+/*
+   dmr_bench
+   scripted benchmarks of the playback pipeline, run without a display:
+   mpv is driven in headless mode and the app runs on the offscreen
+   platform. test media is encoded locally with libav, bit-exact, so runs
+   on different machines measure the same files. results go out as json,
+   one object per scenario, meant to be diffed between releases.
+
+   dmr_bench [--files N] [--runs N] [--items N] [--seed N] [--workdir dir]
+             [--output file]
+*/
+#include <player_engine.h>
+#include <player_backend.h>
+#include <playlist_model.h>
+#include <persistent_manager.h>
+#include <mpv_proxy.h>
+#include <thumbnail_worker.h>
+
+#include <QtWidgets>
+#include <functional>
+#include <random>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+}
+#include <mpv/client.h>
+
+using namespace dmr;
+
+static const int BENCH_SCHEMA = 1;
+
+/* media */
+
+struct ClipSpec {
+    QSize size;
+    int secs;
+    int fps;
+    int seed;
+};
+
+static bool drainEncoder(AVFormatContext *fmt, AVCodecContext *enc, AVStream *st, AVPacket *pkt)
+{
+    int ret;
+    while ((ret = avcodec_receive_packet(enc, pkt)) == 0) {
+        av_packet_rescale_ts(pkt, enc->time_base, st->time_base);
+        pkt->stream_index = st->index;
+        if (av_interleaved_write_frame(fmt, pkt) < 0) {
+            return false;
+        }
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+// moving gradient with a sliding block, one keyframe per second
+static void fillFrame(AVFrame *f, int n, int seed)
+{
+    int bx = (n * 4 + seed * 31) % qMax(1, f->width - 16);
+    for (int y = 0; y < f->height; y++) {
+        auto *l = f->data[0] + y * f->linesize[0];
+        for (int x = 0; x < f->width; x++) {
+            bool block = x >= bx && x < bx + 16 && y >= 16 && y < 32;
+            l[x] = block ? 235 : (x + y + n * 3 + seed * 17) & 0xff;
+        }
+    }
+    for (int y = 0; y < f->height / 2; y++) {
+        auto *u = f->data[1] + y * f->linesize[1];
+        auto *v = f->data[2] + y * f->linesize[2];
+        for (int x = 0; x < f->width / 2; x++) {
+            u[x] = (128 + x + n) & 0xff;
+            v[x] = (64 + y - n) & 0xff;
+        }
+    }
+}
+
+static bool encodeClip(const QString &path, const ClipSpec &spec)
+{
+    AVFormatContext *fmt = nullptr;
+    AVCodecContext *enc = nullptr;
+    AVFrame *frame = nullptr;
+    AVPacket *pkt = nullptr;
+    bool ok = false;
+
+    auto codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (!codec) {
+        qWarning() << "no mpeg4 encoder in libavcodec";
+        return false;
+    }
+
+    if (avformat_alloc_output_context2(&fmt, NULL, NULL, path.toUtf8().constData()) < 0) {
+        return false;
+    }
+    fmt->flags |= AVFMT_FLAG_BITEXACT;
+
+    auto *st = avformat_new_stream(fmt, NULL);
+    enc = avcodec_alloc_context3(codec);
+    if (!st || !enc) goto out;
+
+    enc->width = spec.size.width();
+    enc->height = spec.size.height();
+    enc->time_base = AVRational{1, spec.fps};
+    enc->framerate = AVRational{spec.fps, 1};
+    enc->pix_fmt = AV_PIX_FMT_YUV420P;
+    enc->gop_size = spec.fps;
+    enc->max_b_frames = 0;
+    enc->bit_rate = spec.size.width() * spec.size.height() * 4;
+    enc->thread_count = 1;
+    enc->flags |= AV_CODEC_FLAG_BITEXACT;
+    if (fmt->oformat->flags & AVFMT_GLOBALHEADER) {
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(enc, codec, NULL) < 0) goto out;
+    if (avcodec_parameters_from_context(st->codecpar, enc) < 0) goto out;
+    st->time_base = enc->time_base;
+
+    if (avio_open(&fmt->pb, path.toUtf8().constData(), AVIO_FLAG_WRITE) < 0) goto out;
+    if (avformat_write_header(fmt, NULL) < 0) goto close;
+
+    frame = av_frame_alloc();
+    pkt = av_packet_alloc();
+    frame->format = enc->pix_fmt;
+    frame->width = enc->width;
+    frame->height = enc->height;
+    if (av_frame_get_buffer(frame, 0) < 0) goto close;
+
+    for (int n = 0; n < spec.secs * spec.fps; n++) {
+        if (av_frame_make_writable(frame) < 0) goto close;
+        fillFrame(frame, n, spec.seed);
+        frame->pts = n;
+        if (avcodec_send_frame(enc, frame) < 0 || !drainEncoder(fmt, enc, st, pkt)) {
+            goto close;
+        }
+    }
+    avcodec_send_frame(enc, NULL);
+    ok = drainEncoder(fmt, enc, st, pkt) && av_write_trailer(fmt) == 0;
+
+close:
+    avio_closep(&fmt->pb);
+out:
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&enc);
+    avformat_free_context(fmt);
+    if (!ok) {
+        qWarning() << "failed to encode" << path;
+    }
+    return ok;
+}
+
+// n copies of one encoded clip under dir
+static QList<QUrl> makeClipSet(const QString &dir, int n, const ClipSpec &spec)
+{
+    QList<QUrl> urls;
+    QDir().mkpath(dir);
+    auto seed = QString("%1/seed.mkv").arg(dir);
+    if (!encodeClip(seed, spec)) return urls;
+
+    for (int i = 0; i < n; i++) {
+        auto path = QString("%1/clip_%2.mkv").arg(dir).arg(i, 5, 10, QChar('0'));
+        if (!QFile::copy(seed, path)) {
+            qWarning() << "failed to copy" << path;
+            return QList<QUrl>();
+        }
+        urls.append(QUrl::fromLocalFile(path));
+    }
+    QFile::remove(seed);
+    return urls;
+}
+
+/* measuring */
+
+// runs the event loop until pred holds, rechecked whenever sig fires
+template <typename Sender, typename Signal>
+static bool waitFor(Sender *sender, Signal sig, const std::function<bool()> &pred,
+                    int timeout = 10000)
+{
+    if (pred()) return true;
+
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &loop, [&]() { loop.exit(1); });
+    QObject::connect(sender, sig, &loop, [&]() {
+        if (pred()) loop.exit(0);
+    });
+    timer.start(timeout);
+    return loop.exec() == 0;
+}
+
+class Samples
+{
+public:
+    void add(qint64 ns) { _ns.append(ns); }
+    void fail() { _failed++; }
+
+    QJsonObject toJson() const
+    {
+        auto v = _ns;
+        std::sort(v.begin(), v.end());
+        auto ms = [](qint64 ns) { return qRound64(ns / 1000.0) / 1000.0; };
+        auto at = [&](double q) { return v.isEmpty() ? 0 : v[qMin(v.size() - 1, (int)(q * v.size()))]; };
+
+        qint64 sum = 0;
+        for (auto ns : v) sum += ns;
+
+        QJsonObject o;
+        o["runs"] = v.size();
+        o["failed"] = _failed;
+        o["min_ms"] = ms(v.isEmpty() ? 0 : v.first());
+        o["median_ms"] = ms(at(0.5));
+        o["p95_ms"] = ms(at(0.95));
+        o["max_ms"] = ms(v.isEmpty() ? 0 : v.last());
+        o["mean_ms"] = ms(v.isEmpty() ? 0 : sum / v.size());
+        return o;
+    }
+
+private:
+    QVector<qint64> _ns;
+    int _failed {0};
+};
+
+/* scenarios */
+
+// what the playlist does per file: cache lookup, on a miss probe and store
+static QJsonObject benchCache(const QList<QUrl> &urls)
+{
+    Samples cold, warm;
+    for (const auto &url : urls) {
+        QElapsedTimer t;
+        t.start();
+        auto ci = PersistentManager::get().loadFromCache(url);
+        if (ci.mi_valid) {
+            cold.fail();
+            continue;
+        }
+        QFileInfo fi(url.toLocalFile());
+        bool ok = false;
+        auto mi = MovieInfo::parseFromFile(fi, &ok);
+        PlayItemInfo pif { true, ok, url, fi, QPixmap(), mi };
+        if (ok) PersistentManager::get().save(pif);
+        ok ? cold.add(t.nsecsElapsed()) : cold.fail();
+    }
+
+    for (const auto &url : urls) {
+        QElapsedTimer t;
+        t.start();
+        auto ci = PersistentManager::get().loadFromCache(url);
+        ci.mi_valid ? warm.add(t.nsecsElapsed()) : warm.fail();
+    }
+
+    QJsonObject o;
+    o["cold"] = cold.toJson();
+    o["warm"] = warm.toJson();
+    return o;
+}
+
+// whole batch through appendAsync, once with nothing cached and once again
+static QJsonObject benchImport(PlayerEngine &engine, const QList<QUrl> &urls)
+{
+    auto &pl = engine.playlist();
+    QJsonObject o;
+    o["files"] = urls.size();
+
+    for (auto pass : {"cold", "warm"}) {
+        pl.clear();
+        Samples s;
+        QElapsedTimer t;
+        t.start();
+        pl.appendAsync(urls);
+        if (waitFor(&pl, &PlaylistModel::countChanged,
+                    [&]() { return pl.count() >= urls.size(); }, 120000)) {
+            s.add(t.nsecsElapsed());
+        } else {
+            s.fail();
+        }
+        o[pass] = s.toJson();
+    }
+    return o;
+}
+
+// the url index of a large playlist against a plain list doing the same
+// edits. items are stream urls, so nothing is probed and only the model
+// is measured
+static QJsonObject benchPlaylistIndex(PlayerEngine &engine, int items, int runs,
+                                      std::mt19937 &rng)
+{
+    auto &pl = engine.playlist();
+    pl.clear();
+
+    auto itemUrl = [](int i) {
+        return QUrl(QString("http://bench.invalid/item_%1.mkv").arg(i));
+    };
+
+    QList<QUrl> expected;
+    Samples append;
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < items; i++) {
+        auto url = itemUrl(i);
+        pl.append(url);
+        expected.append(url);
+    }
+    append.add(t.nsecsElapsed());
+
+    int errors = 0;
+    if (pl.count() != expected.size()) errors++;
+
+    // appending a listed url must not change anything
+    Samples dedup;
+    std::uniform_int_distribution<int> any(0, items - 1);
+    for (int i = 0; i < runs; i++) {
+        t.start();
+        pl.append(itemUrl(any(rng)));
+        dedup.add(t.nsecsElapsed());
+    }
+    if (pl.count() != expected.size()) errors++;
+
+    int edits = qMax(runs, items / 100);
+    Samples remove, move;
+    QList<QUrl> removed;
+    for (int i = 0; i < edits && expected.size() > 2; i++) {
+        std::uniform_int_distribution<int> pos(0, expected.size() - 1);
+
+        int at = pos(rng);
+        removed.append(expected.takeAt(at));
+        t.start();
+        pl.remove(at);
+        remove.add(t.nsecsElapsed());
+
+        std::uniform_int_distribution<int> left(0, expected.size() - 1);
+        int src = left(rng), target = left(rng);
+        expected.move(src, target);
+        t.start();
+        pl.switchPosition(src, target);
+        move.add(t.nsecsElapsed());
+    }
+
+    Samples lookup;
+    if (pl.count() != expected.size()) errors++;
+    for (int i = 0; i < expected.size(); i++) {
+        t.start();
+        int id = pl.indexOf(expected[i]);
+        lookup.add(t.nsecsElapsed());
+        if (id != i || pl.items().url(i) != expected[i]) errors++;
+    }
+    for (const auto &url : removed) {
+        if (pl.indexOf(url) >= 0) errors++;
+    }
+
+    pl.clear();
+    if (pl.count() != 0 || pl.indexOf(itemUrl(0)) >= 0) errors++;
+
+    if (errors) {
+        qWarning() << "playlist index:" << errors << "inconsistencies";
+    }
+
+    QJsonObject o;
+    o["items"] = items;
+    o["errors"] = errors;
+    o["append_all"] = append.toJson();
+    o["dedup"] = dedup.toJson();
+    o["remove"] = remove.toJson();
+    o["switch_position"] = move.toJson();
+    o["index_of"] = lookup.toJson();
+    return o;
+}
+
+static QJsonObject benchTrackSwitch(PlayerEngine &engine, int runs)
+{
+    auto &pl = engine.playlist();
+    Samples s;
+
+    int loaded = 0;
+    auto conn = QObject::connect(&engine, &PlayerEngine::fileLoaded, [&]() { loaded++; });
+
+    engine.play();
+    if (!waitFor(&engine, &PlayerEngine::fileLoaded, [&]() { return loaded > 0; })) {
+        QObject::disconnect(conn);
+        s.fail();
+        return s.toJson();
+    }
+
+    for (int i = 0; i < runs; i++) {
+        int before = loaded;
+        QElapsedTimer t;
+        t.start();
+        pl.playNext(true);
+        if (waitFor(&engine, &PlayerEngine::fileLoaded, [&]() { return loaded > before; })) {
+            s.add(t.nsecsElapsed());
+        } else {
+            s.fail();
+        }
+    }
+
+    QObject::disconnect(conn);
+    return s.toJson();
+}
+
+static QJsonObject benchSeek(PlayerEngine &engine, const QUrl &clip, int secs,
+                             int runs, std::mt19937 &rng)
+{
+    Samples s;
+    auto *mpv = engine.findChild<MpvProxy *>();
+    if (!mpv) {
+        s.fail();
+        return s.toJson();
+    }
+
+    engine.clearPlaylist();
+    int loaded = 0;
+    auto conn = QObject::connect(&engine, &PlayerEngine::fileLoaded, [&]() { loaded++; });
+    engine.addPlayFile(clip);
+    engine.playByName(clip);
+    bool started = waitFor(&engine, &PlayerEngine::fileLoaded, [&]() { return loaded > 0; });
+    QObject::disconnect(conn);
+    if (!started) {
+        s.fail();
+        return s.toJson();
+    }
+
+    std::uniform_int_distribution<int> pos(1, secs - 2);
+    for (int i = 0; i < runs; i++) {
+        // a target next to the current position would count as reached
+        // before the seek did anything
+        int target = pos(rng);
+        for (int n = 0; n < 16 && qAbs(mpv->elapsed() - target) <= 2; n++)
+            target = pos(rng);
+
+        int changes = 0;
+        auto counter = QObject::connect(mpv, &Backend::elapsedChanged, [&]() { changes++; });
+        QElapsedTimer t;
+        t.start();
+        mpv->seekAbsolute(target);
+        // elapsed is reported in whole secs once mpv restarted playback
+        if (waitFor(mpv, &Backend::elapsedChanged,
+                    [&]() { return changes > 0 && qAbs(mpv->elapsed() - target) <= 1; })) {
+            s.add(t.nsecsElapsed());
+        } else {
+            s.fail();
+        }
+        QObject::disconnect(counter);
+    }
+
+    return s.toJson();
+}
+
+// hover positions are previewed cold first, then the same ones again
+static QJsonObject benchPreview(const QUrl &clip, int secs, int runs, std::mt19937 &rng)
+{
+    auto &tw = ThumbnailWorker::get();
+    std::uniform_int_distribution<int> pos(0, secs - 1);
+    QList<int> points;
+    for (int i = 0; i < runs; i++) points.append(pos(rng));
+
+    Samples cold, warm;
+    for (auto secs : points) {
+        QElapsedTimer t;
+        t.start();
+        if (!tw.isThumbGenerated(clip, secs)) {
+            tw.requestThumb(clip, secs);
+            if (!waitFor(&tw, &ThumbnailWorker::thumbGenerated,
+                         [&]() { return tw.isThumbGenerated(clip, secs); })) {
+                cold.fail();
+                continue;
+            }
+        }
+        tw.getThumb(clip, secs).isNull() ? cold.fail() : cold.add(t.nsecsElapsed());
+    }
+
+    for (auto secs : points) {
+        QElapsedTimer t;
+        t.start();
+        bool hit = tw.isThumbGenerated(clip, secs) && !tw.getThumb(clip, secs).isNull();
+        hit ? warm.add(t.nsecsElapsed()) : warm.fail();
+    }
+
+    QJsonObject o;
+    o["cold"] = cold.toJson();
+    o["warm"] = warm.toJson();
+    o["cache"] = QJsonObject {
+        {"hits", tw.cacheStats().hits},
+        {"misses", tw.cacheStats().misses},
+    };
+    return o;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QTemporaryDir tmp;
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        {"files", "number of files to import", "N", "200"},
+        {"runs", "repetitions of the seek, preview and switch scenarios", "N", "20"},
+        {"items", "entries of the playlist index scenario", "N", "100000"},
+        {"seed", "seed of the random positions", "N", "1"},
+        {"workdir", "where media, config and caches go", "dir"},
+        {"output", "json results, stdout if not given", "file"},
+    });
+
+    // caches and settings must not leak in from the user's profile, so
+    // the config location is redirected before the app is up
+    QStringList args;
+    for (int i = 0; i < argc; i++) args << QString::fromLocal8Bit(argv[i]);
+    parser.parse(args);
+    auto workdir = parser.isSet("workdir") ? parser.value("workdir") : tmp.path();
+    QDir().mkpath(workdir);
+    qputenv("XDG_CONFIG_HOME", QString("%1/config").arg(workdir).toLocal8Bit());
+
+    QApplication app(argc, argv);
+    app.setOrganizationName("deepin");
+    app.setApplicationName("dmr_bench");
+    parser.process(app);
+
+    // required by mpv
+    setlocale(LC_NUMERIC, "C");
+    Backend::setHeadlessMode(Backend::HeadlessMode::HeadlessNull);
+
+    int files = qMax(1, parser.value("files").toInt());
+    int runs = qMax(1, parser.value("runs").toInt());
+    int items = qMax(3, parser.value("items").toInt());
+    std::mt19937 rng(parser.value("seed").toUInt());
+
+    QJsonObject config {
+        {"files", files},
+        {"runs", runs},
+        {"items", items},
+        {"seed", parser.value("seed").toInt()},
+    };
+    QJsonObject env {
+        {"qt", qVersion()},
+        {"libavformat", LIBAVFORMAT_IDENT},
+        {"libavcodec", LIBAVCODEC_IDENT},
+        {"mpv_client_api", QString::number(mpv_client_api_version(), 16)},
+    };
+
+    const ClipSpec small {{160, 90}, 2, 25, 1};
+    const ClipSpec feature {{640, 360}, 30, 25, 2};
+
+    QElapsedTimer gen;
+    gen.start();
+    auto importUrls = makeClipSet(workdir + "/import", files, small);
+    auto cacheUrls = makeClipSet(workdir + "/cache", files, small);
+    auto clip = QString("%1/main.mkv").arg(workdir);
+    if (importUrls.isEmpty() || cacheUrls.isEmpty() || !encodeClip(clip, feature)) {
+        qCritical() << "can not generate test media";
+        return 1;
+    }
+    env["media_generation_ms"] = gen.elapsed();
+
+    QJsonObject results;
+    results["cache"] = benchCache(cacheUrls);
+
+    {
+        PlayerEngine engine;
+        engine.setBackendProperty("pause-on-start", "true");
+        results["playlist_index"] = benchPlaylistIndex(engine, items, runs, rng);
+        results["import"] = benchImport(engine, importUrls);
+        results["track_switch"] = benchTrackSwitch(engine, runs);
+        results["seek"] = benchSeek(engine, QUrl::fromLocalFile(clip), feature.secs, runs, rng);
+        engine.stop();
+        waitFor(&engine, &PlayerEngine::stateChanged,
+                [&]() { return engine.state() == PlayerEngine::Idle; });
+    }
+
+    results["hover_preview"] = benchPreview(QUrl::fromLocalFile(clip), feature.secs, runs, rng);
+    ThumbnailWorker::get().stop();
+    ThumbnailWorker::get().wait();
+
+    QJsonObject root {
+        {"schema", BENCH_SCHEMA},
+        {"config", config},
+        {"environment", env},
+        {"results", results},
+    };
+    auto json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet("output")) {
+        QSaveFile f(parser.value("output"));
+        if (!f.open(QIODevice::WriteOnly) || f.write(json) != json.size() || !f.commit()) {
+            qCritical() << "can not write" << parser.value("output");
+            return 1;
+        }
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    return 0;
+}
@@ -30,6 +30,7 @@
 #include "player_engine.h"
 #include "burst_screenshots_dialog.h"
 #include "dmr_settings.h"
+#include "screenshot_writer.h"
 #include "utils.h"
 
 #include <DThemeManager>
@@ -181,17 +182,20 @@ void BurstScreenshotsDialog::savePoster()
     m_titlebar->setFixedWidth(610);
     auto img = this->grab(rect().marginsRemoved(QMargins(10, 0, 10, 45)));
     _posterPath = Settings::get().screenshotNameTemplate();
-    img.save(_posterPath);
+    ScreenshotWriter::get().save(img.toImage(), _posterPath);
     DAbstractDialog::accept();
 }
 
 void BurstScreenshotsDialog::saveShootings()
 {
+    // one batch, so the burst is reported once and not per frame
+    QList<QPair<QImage, QString>> shots;
     int i = 1;
     for (auto& img: _thumbs) {
         auto file_path = Settings::get().screenshotNameSeqTemplate().arg(i++);
-        img.first.save(file_path);
+        shots.append(qMakePair(img.first, file_path));
     }
+    ScreenshotWriter::get().saveBatch(shots);
     DAbstractDialog::accept();
 }
 
@@ -29,6 +29,7 @@
  */
 #include "playlist_widget.h"
 #include "playlist_model.h"
+#include "playlist_store.h"
 #include "compositing_manager.h"
 #include "player_engine.h"
 #include "toolbox_proxy.h"
@@ -36,7 +37,6 @@
 #include "mainwindow.h"
 #include "utils.h"
 #include "movieinfo_dialog.h"
-#include "tip.h"
 
 #include <DApplication>
 #include <dimagebutton.h>
@@ -79,523 +79,358 @@ QString splitText(const QString &text, int width,
 
     return str;
 }
-class PlayItemTooltipHandler: public QObject
-{
-public:
-    PlayItemTooltipHandler(QObject *parent): QObject(parent) {}
-
-protected:
-    bool eventFilter(QObject *obj, QEvent *event)
-    {
-        switch (event->type()) {
-        case QEvent::ToolTip: {
-            QHelpEvent *he = static_cast<QHelpEvent *>(event);
-            auto tip = obj->property("HintWidget").value<Tip *>();
-            auto item = tip->property("for").value<QWidget *>();
-            auto lb = tip->findChild<DLabel *>("TipText");
-            lb->setAlignment(Qt::AlignLeft);
-
-//            auto msg = splitText(item->toolTip(), 200, QTextOption::WordWrap, lb->font(),
-//                                 lb->fontMetrics().height());
-//            lb->setText(msg);
-            tip->update();
-            tip->show();
-            tip->adjustSize();
-            tip->raise();
-            auto pos = he->globalPos() + QPoint{0, 10};
-            auto dw = qApp->desktop()->availableGeometry(item).width();
-            if (pos.x() + tip->width() > dw) {
-                pos.rx() = dw - tip->width();
-            }
-            tip->move(pos);
-            return true;
-        }
-
-        case QEvent::Leave: {
-            auto tip = obj->property("HintWidget").value<Tip *>();
-            tip->hide();
-            event->ignore();
+static const char *kRowMimeType = "application/x-dmr-playlist-row";
 
-        }
-        default:
-            break;
-        }
-        // standard event processing
-        return QObject::eventFilter(obj, event);
-    }
-};
-
-enum ItemState {
-    Normal,
-    Playing,
-    Invalid, // gets deleted or similar
-};
-
-class PlayItemWidget: public QFrame
+/* class PlaylistItemModel
+ * list model over PlaylistModel. rows are read straight out of the
+ * PlaylistStore when the view asks for them, and PlaylistModel's
+ * notifications are forwarded as incremental row inserts/removes, so
+ * appending to a large playlist never rebuilds what's already shown.
+ */
+class PlaylistItemModel: public QAbstractListModel
 {
     Q_OBJECT
-    Q_PROPERTY(QString bg READ getBg WRITE setBg DESIGNABLE true)
 public:
-    friend class PlaylistWidget;
-
-    PlayItemWidget(const PlayItemInfo &pif, QListWidget *list = 0, int index = 0, PlaylistWidget *parent = nullptr)
-        : QFrame(), _pif {pif}, _listWidget {list}, _playlist{parent}
+    enum Roles {
+        UrlRole = Qt::UserRole + 1,
+        DurationRole,
+        ValidRole,
+        PlayingRole,
+    };
+
+    PlaylistItemModel(PlaylistModel *pl, QObject *parent)
+        : QAbstractListModel(parent), _pl {pl}
     {
-//        DThemeManager::instance()->registerWidget(this, QStringList() << "PlayItemThumb");
-
-        setProperty("PlayItemThumb", "true");
-        setState(ItemState::Normal);
-        setFrameShape(QFrame::NoFrame);
-
-        auto kd = "local";
-        if (!_pif.url.isLocalFile()) {
-            if (_pif.url.scheme().startsWith("dvd")) {
-                kd = "dvd";
-            } else {
-                kd = "network";
-            }
-        }
-        setProperty("ItemKind", kd);
-
-        // it's the same for all themes
-        _play = QPixmap(":/resources/icons/dark/normal/film-top.svg");
-        _play.setDevicePixelRatio(qApp->devicePixelRatio());
-
-        setFixedSize(_playlist->width() - 250, 36);
-        auto *l = new QHBoxLayout(this);
-        l->setContentsMargins(17, 0, 0, 0);
-        l->setSpacing(10);
-        setLayout(l);
-
-        _index = new DLabel(this);
-        DFontSizeManager::instance()->bind(_index, DFontSizeManager::T9);
-        _index->setText(QString::number(index + 1));
-        _index->setFixedWidth(22);
-        l->addWidget(_index);
-
-
-        _thumb = new ListPic(_pif.thumbnail.scaled(QSize(42, 24)), this);
-//        _thumb->setPixmap(_pif.thumbnail.scaled(QSize(42,24)));
-        l->addWidget(_thumb);
-
-        auto *vl = new QHBoxLayout;
-        vl->setContentsMargins(0, 0, 0, 0);
-        vl->setSpacing(0);
-        l->addLayout(vl);
-
-//        vl->addStretch();
-
-        _name = new DLabel(this);
-        _name->setProperty("Name", true);
-//        _name->setReadOnly(true);
-//        _name->setAcceptRichText(false);
-//        _name->setWordWrapMode(QTextOption::NoWrap);
-//        _name->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-//        _name->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-        _name->setFrameShape(QFrame::NoFrame);
-        _name->setTextInteractionFlags(Qt::NoTextInteraction);
-        _name->setFixedWidth(width() - 180);
-//        _name->setStyleSheet("background: red;");
-        _name->installEventFilter(this);
-//        _name->viewport()->setAutoFillBackground(false);
-        _name->setAutoFillBackground(false);
-
-        vl->addWidget(_name);
-//        vl->addStretch(1);
-
-        _time = new DLabel(this);
-        DFontSizeManager::instance()->bind(_time, DFontSizeManager::T9);
-        _time->setProperty("Time", true);
-        _time->setText(_pif.mi.durationStr());
-        if (!_pif.valid) {
-            setState(ItemState::Invalid);
-            _time->setText(tr("The file does not exist"));
-        }
-//        vl->addWidget(_time);
-        vl->addStretch();
-        l->addWidget(_time);
-        l->addSpacing(10);
-
-//        setBg(QString(":/resources/icons/%1/normal/film-bg.svg").arg(qApp->theme()));
-
-        //_closeBtn = new FloatingButton(this);
-        _closeBtn = new DFloatingButton(DStyle::SP_CloseButton, this);
-        _closeBtn->setIconSize(QSize(28, 28));
-        _closeBtn->setFixedSize(25, 25);
-        _closeBtn->setObjectName("CloseBtn");
-        _closeBtn->hide();
-        connect(_closeBtn, &DFloatingButton::clicked, this, &PlayItemWidget::closeButtonClicked);
-        //connect(_closeBtn, &FloatingButton::clicked, this, &PlayItemWidget::closeButtonClicked);
-        //connect(_closeBtn, &FloatingButton::mouseHover, this, &PlayItemWidget::closeBtnStates);
-
-
-        setToolTip(_pif.mi.title);
-        auto th = new PlayItemTooltipHandler(this);
-        auto t = new Tip(QPixmap(), _pif.mi.title, NULL);
-        t->setWindowFlags(Qt::ToolTip | Qt::CustomizeWindowHint);
-        t->setText(_pif.mi.title);
-        t->resetSize(QApplication::desktop()->availableGeometry().width());
-        t->setAttribute(Qt::WA_TranslucentBackground);
-        t->setProperty("for", QVariant::fromValue<QWidget *>(this));
-        t->layout()->setContentsMargins(5, 10, 5, 10);
-        t->hide();
-        setProperty("HintWidget", QVariant::fromValue<QWidget *>(t));
-        installEventFilter(th);
-        connect(_playlist, &PlaylistWidget::sizeChange, this, [ = ] {
-            setFixedWidth(_playlist->width() - 250);
-//            setFixedSize(_playlist->width(), 36);
-        });
+        _thumbs.setMaxCost(256);
+        _rows = _pl->count();
+        _current = _pl->current();
+
+        connect(_pl, &PlaylistModel::emptied, this, &PlaylistItemModel::reload);
+        connect(_pl, &PlaylistModel::itemsAppended, this, &PlaylistItemModel::syncRows);
+        connect(_pl, &PlaylistModel::countChanged, this, &PlaylistItemModel::syncRows);
+        connect(_pl, &PlaylistModel::itemRemoved, this, &PlaylistItemModel::onItemRemoved);
+        connect(_pl, &PlaylistModel::itemInserted, this, &PlaylistItemModel::onItemInserted);
+        connect(_pl, &PlaylistModel::itemInfoUpdated, this, &PlaylistItemModel::onItemInfoUpdated);
+        // switchPosition() reports the new current while a row move is still open
+        connect(_pl, &PlaylistModel::currentChanged, this, &PlaylistItemModel::onCurrentChanged,
+                Qt::QueuedConnection);
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : _rows;
     }
 
-    void updateInfo(const PlayItemInfo &pif)
+    QVariant data(const QModelIndex &index, int role) const override
     {
-        _pif = pif;
-        _time->setText(_pif.mi.durationStr());
-        setToolTip(_pif.mi.title);
-        updateNameText();
-
-        if (!_pif.valid) {
-            setState(ItemState::Invalid);
-            _time->setText(tr("The file does not exist"));
+        const auto &items = _pl->items();
+        int row = index.row();
+        if (!index.isValid() || row >= _rows || row >= items.size())
+            return QVariant();
+
+        switch (role) {
+        case Qt::DisplayRole:
+        case Qt::ToolTipRole:
+            return items.title(row);
+        case Qt::DecorationRole:
+            return thumbnail(row);
+        case UrlRole:
+            return items.url(row);
+        case DurationRole:
+            return utils::Time2str(items.duration(row));
+        case ValidRole:
+            return items.isValid(row);
+        case PlayingRole:
+            return row == _pl->current();
+        default:
+            break;
         }
-//        setStyleSheet(styleSheet());
-        update();
+        return QVariant();
     }
 
-    void setState(ItemState is)
+    Qt::ItemFlags flags(const QModelIndex &index) const override
     {
-        setProperty("ItemState", is);
-        update();
+        if (!index.isValid())
+            return Qt::ItemIsDropEnabled;
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
     }
 
-    ItemState state() const
+    Qt::DropActions supportedDropActions() const override
     {
-        return (ItemState)property("ItemState").toInt();
-    }
-    void setIndex(int index)
-    {
-        _index->setText(QString::number(index + 1));
+        return Qt::MoveAction;
     }
 
-    QString getBg() const
-    {
-        return _bg;
-    }
-    void setBg(const QString &s)
+    QStringList mimeTypes() const override
     {
-        _bg = s;
-
-        auto dpr = qApp->devicePixelRatio();
-
-        QPixmap pm = QPixmap::fromImage(utils::LoadHiDPIImage(s));
-
-        QPixmap dest(pm.size());
-        dest.setDevicePixelRatio(dpr);
-        dest.fill(Qt::transparent);
-        QPainter p(&dest);
-
-        if (state() == ItemState::Invalid) {
-            p.setOpacity(0.5);
-        }
-
-        // thumb size
-        QSize sz(22, 40);
-        sz *= dpr;
-
-        p.drawPixmap(0, 0, pm);
-
-        if (!_pif.thumbnail.isNull()) {
-            auto img = _pif.thumbnail.scaledToHeight(sz.height(), Qt::SmoothTransformation);
-            img.setDevicePixelRatio(dpr);
-
-            QPointF target_pos((pm.width() - sz.width()) / 2, (pm.height() - sz.height()) / 2);
-            target_pos /= dpr;
-
-            QRectF src_rect((img.width() - sz.width()) / 2, (img.height() - sz.height()) / 2,
-                            sz.width(), sz.height());
-            p.drawPixmap(target_pos, img, src_rect);
-
-        }
-
-        if (state() == ItemState::Playing) {
-            QPointF pos((pm.width() - _play.width()) / 2, (pm.height() - _play.height()) / 2);
-            pos /= dpr;
-            p.drawPixmap(pos, _play);
-        }
-        p.end();
-
-        _thumb->setPixmap(dest);
+        return {kRowMimeType};
     }
 
-    void setHovered(bool v)
+    QMimeData *mimeData(const QModelIndexList &indexes) const override
     {
-        if (_hovered != v) {
-            _hovered = v;
-            setProperty("hovered", v);
-//            setStyleSheet(styleSheet());
-        }
+        if (indexes.isEmpty())
+            return nullptr;
+
+        auto *md = new QMimeData;
+        md->setData(kRowMimeType, QByteArray::number(indexes.first().row()));
+        return md;
     }
 
-    void setCurItemHovered(bool v)
+    bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column,
+                      const QModelIndex &parent) override
     {
-        if (_hovered != v) {
-            _hovered = v;
-            setProperty("hovered", v);
-        }
+        Q_UNUSED(column);
+        if (action != Qt::MoveAction || !data->hasFormat(kRowMimeType))
+            return false;
 
-        if (v) {
-            _closeBtn->show();
-            _closeBtn->raise();
-        } else {
-            _closeBtn->hide();
-        }
+        bool ok = false;
+        int src = data->data(kRowMimeType).toInt(&ok);
+        if (!ok)
+            return false;
 
-        updateClosePosition();
-        update();
+        if (row < 0)
+            row = parent.isValid() ? parent.row() : _rows;
+        return moveRows(QModelIndex(), src, 1, QModelIndex(), row);
     }
 
-    bool getBIsSelect() const
+    bool moveRows(const QModelIndex &srcParent, int src, int count,
+                  const QModelIndex &dstParent, int dst) override
     {
-        return m_bIsSelect;
+        if (srcParent.isValid() || dstParent.isValid() || count != 1)
+            return false;
+        if (src < 0 || src >= _rows || dst < 0 || dst > _rows)
+            return false;
+
+        // dst is an insertion point counted before the move,
+        // switchPosition() wants the row the item ends up at
+        int target = dst > src ? dst - 1 : dst;
+        if (target == src || !beginMoveRows(QModelIndex(), src, src, QModelIndex(), dst))
+            return false;
+
+        qDebug() << "drag to move " << src << target;
+        _pl->switchPosition(src, target);
+        endMoveRows();
+        return true;
     }
 
-    void setBIsSelect(bool bIsSelect)
+public slots:
+    void reload()
     {
-        m_bIsSelect = bIsSelect;
-        update();
+        beginResetModel();
+        _thumbs.clear();
+        _rows = _pl->count();
+        _current = _pl->current();
+        endResetModel();
     }
 
-    void doDoubleClick()
+private slots:
+    void syncRows()
     {
-        //FIXME: there is an potential inconsistency with model if pif did changed
-        //(i.e gets deleted).
-        _pif.refresh();
-        _time->setText(_pif.mi.durationStr());
-        if (!_pif.valid) {
-            setState(ItemState::Invalid);
-            _time->setText(tr("The file does not exist"));
-        }
-//        setStyleSheet(styleSheet());
-        if (!_pif.url.isLocalFile() || _pif.info.exists()) {
-            emit doubleClicked();
+        int n = _pl->count();
+        if (n < _rows) {
+            reload();
+        } else if (n > _rows) {
+            beginInsertRows(QModelIndex(), _rows, n - 1);
+            _rows = n;
+            endInsertRows();
         }
     }
 
-signals:
-    void closeButtonClicked();
-    void doubleClicked();
-
-private slots:
-    void closeBtnStates(bool bHover)
+    void onItemRemoved(int pos)
     {
-        setCurItemHovered(bHover);
-    }
+        if (pos < 0 || pos >= _rows || _pl->count() != _rows - 1) {
+            reload();
+            return;
+        }
 
+        beginRemoveRows(QModelIndex(), pos, pos);
+        _rows--;
+        endRemoveRows();
 
-protected:
-    void updateClosePosition()
-    {
-        auto margin = 10;
-        auto pl = dynamic_cast<QListWidget *>(parentWidget()->parentWidget());
-//        if (pl->verticalScrollBar()->isVisible())
-//            margin = 10;
-        _closeBtn->move(width() - _closeBtn->width() - margin,
-                        (height() - _closeBtn->height()) / 2);
+        // every row below changed its displayed number
+        if (pos < _rows)
+            emit dataChanged(index(pos), index(_rows - 1), {Qt::DisplayRole});
     }
 
-    void leaveEvent(QEvent *e) override
+    void onItemInserted(int pos)
     {
-        _closeBtn->hide();
-        setHovered(false);
-    }
+        if (pos < 0 || pos > _rows || _pl->count() != _rows + 1) {
+            reload();
+            return;
+        }
 
-    void enterEvent(QEvent *e) override
-    {
-        _closeBtn->show();
-        _closeBtn->raise();
+        beginInsertRows(QModelIndex(), pos, pos);
+        _rows++;
+        endInsertRows();
 
-        updateClosePosition();
-        setHovered(true);
+        // every row below changed its displayed number
+        if (pos + 1 < _rows)
+            emit dataChanged(index(pos + 1), index(_rows - 1), {Qt::DisplayRole});
     }
 
-    bool eventFilter(QObject *obj, QEvent *e) override
+    void onItemInfoUpdated(int id)
     {
-        if (e->type() == QEvent::MouseButtonDblClick) {
-            doDoubleClick();
-            return true;
-        }
-        return QWidget::eventFilter(obj, e);
+        if (id < 0 || id >= _rows)
+            return;
+
+        _thumbs.remove(_pl->items().url(id));
+        emit dataChanged(index(id), index(id));
     }
 
-    void resizeEvent(QResizeEvent *re) override
+    void onCurrentChanged()
     {
-        updateClosePosition();
-        _name->setFixedWidth(width() - 180);
-        updateNameText();
+        int old = _current;
+        _current = _pl->current();
+        if (old >= 0 && old < _rows)
+            emit dataChanged(index(old), index(old), {PlayingRole});
+        if (_current >= 0 && _current < _rows)
+            emit dataChanged(index(_current), index(_current), {PlayingRole});
     }
 
-    bool event(QEvent *ee) override
+private:
+    QPixmap thumbnail(int row) const
     {
-        if (ee->type() == QEvent::Resize) {
-//            int text_height = _name->document()->size().height();
-            _name->setFixedHeight(36);
-        }
+        const auto &items = _pl->items();
+        if (!items.hasThumbnail(row))
+            return QPixmap();
 
-        if (ee->type() == QEvent::Move) {
-//            _closeBtn->hide();
-//            if (isVisible()) {
-//                auto pos = _listWidget->mapFromGlobal(QCursor::pos());
-//                auto r = QRect(mapTo(_listWidget, QPoint()), size());
-//                if (r.contains(pos)) {
-//                    _closeBtn->show();
-//                    _closeBtn->raise();
-//                }
-//            }
-        }
+        const QUrl &url = items.url(row);
+        if (auto *pm = _thumbs.object(url))
+            return *pm;
 
-        return QFrame::event(ee);
-    }
+        auto src = items.thumbnail(row);
+        if (src.isNull())
+            return QPixmap();
 
-    void updateNameText()
-    {
-        _name->setText(utils::ElideText(_pif.mi.title, {width() - 242, 36}, QTextOption::NoWrap,
-                                        _name->font(), Qt::ElideRight, 18, width() - 242));
-//        _name->viewport()->setCursor(Qt::ArrowCursor);
-        _name->setCursor(Qt::ArrowCursor);
-//        _name->document()->setDocumentMargin(0.0);
-//        int text_height = _name->document()->size().height();
-        _name->setFixedHeight(36);
+        auto dpr = qApp->devicePixelRatio();
+        auto pm = src.scaled(QSize(42, 24) * dpr, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        pm.setDevicePixelRatio(dpr);
+        _thumbs.insert(url, new QPixmap(pm));
+        return pm;
     }
 
-    void showEvent(QShowEvent *se) override
-    {
-        updateNameText();
-
-//        QTimer::singleShot(0, [=]() {
-//            auto pos = _listWidget->mapFromGlobal(QCursor::pos());
-//            auto r = QRect(mapTo(_listWidget, QPoint()), size());
-//            if (r.contains(pos)) {
-//                _closeBtn->show();
-//                _closeBtn->raise();
-//                updateClosePosition();
-//            }
-//        });
+    PlaylistModel *_pl {nullptr};
+    int _rows {0};
+    int _current {-1};
+    /// thumbnails already scaled down to row size, keyed by url
+    mutable QCache<QUrl, QPixmap> _thumbs;
+};
 
-    }
+/* class PlaylistItemDelegate
+ * paints a playlist row: index, rounded thumbnail, elided title and
+ * duration. hovered and selected rows get the close button, whose clicks
+ * are reported by closeClicked().
+ */
+class PlaylistItemDelegate: public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    PlaylistItemDelegate(QListView *view): QStyledItemDelegate(view), _view {view} {}
 
-    void mouseDoubleClickEvent(QMouseEvent *me) override
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
     {
-        doDoubleClick();
+        Q_UNUSED(option);
+        Q_UNUSED(index);
+        return QSize(_view->width() - 15, 36);
     }
 
-
-
-    void paintEvent(QPaintEvent *pe)
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override
     {
-        QPainter painter(this);
-        painter.setRenderHint(QPainter::Antialiasing);
-        QRectF bgRect;
-        bgRect.setSize(size());
-        const DPalette pal = QGuiApplication::palette();//this->palette();
-//            DPalette pa = DApplicationHelper::instance()->palette(this);
-//            pa.setBrush(DPalette::WindowText, pa.color(DPalette::TextWarning));
-        DStyleHelper styleHelper;
-        QStyleOption option;
-        if (!(_index->text().toInt() % 2)) {
-
-//            QColor fillColor = styleHelper.getColor(static_cast<const QStyleOption *>(&option), pa, DPalette::ItemBackground);
-//            painter.setBrush(QBrush(fillColor));
-//            painter->fillPath(path, fillColor);
-//            QColor bgColor(0,0,0,8);
-            QColor bgColor  = pal.color(DPalette::AlternateBase);
-
-            QPainterPath pp;
-            pp.addRoundedRect(bgRect, 8, 8);
-            painter.fillPath(pp, bgColor);
-
-        }
-        if (_hovered) {
-            DPalette pa = DApplicationHelper::instance()->palette(this);
-            pa.setBrush(DPalette::Text, pa.color(DPalette::Highlight));
-            QColor bgColor(255, 255, 255, 255 * 0.05);
-            if (DGuiApplicationHelper::LightType == DGuiApplicationHelper::instance()->themeType() ) {
-                bgColor = QColor(0, 0, 0, 255 * 0.05);
-            }
-
-            QPainterPath pp;
-            pp.addRoundedRect(bgRect, 8, 8);
-            painter.fillPath(pp, bgColor);
-
-        }
-        if (state() == ItemState::Playing) {
-            DPalette pa = DApplicationHelper::instance()->palette(this);
-            pa.setBrush(DPalette::Text, pa.color(DPalette::Highlight));
-//            setPalette(pa);
-//            _name->setPalette(pa);
-            _name->setForegroundRole(DPalette::Highlight);
-            _index->setForegroundRole(DPalette::Highlight);
-            _time->setForegroundRole(DPalette::Highlight);
-//            _name->setFontWeight(QFont::Weight::Medium);
-            DFontSizeManager::instance()->bind(_name, DFontSizeManager::T6, QFont::Medium);
-            DFontSizeManager::instance()->bind(_index, DFontSizeManager::T6, QFont::Medium);
-            DFontSizeManager::instance()->bind(_time, DFontSizeManager::T6, QFont::Medium);
-//            QColor bgColor  = pal.color(DPalette::ToolTipBase);
-
+        bool light = DGuiApplicationHelper::LightType == DGuiApplicationHelper::instance()->themeType();
+        bool playing = index.data(PlaylistItemModel::PlayingRole).toBool();
+        bool valid = index.data(PlaylistItemModel::ValidRole).toBool();
+        bool selected = option.state & QStyle::State_Selected;
+        bool hovered = option.state & QStyle::State_MouseOver;
+        const DPalette pal = DApplicationHelper::instance()->palette(_view);
+        QRect rect = option.rect;
+
+        painter->save();
+        painter->setRenderHint(QPainter::Antialiasing);
+
+        QPainterPath pp;
+        pp.addRoundedRect(QRectF(rect), 8, 8);
+        if (index.row() % 2) {
+            painter->fillPath(pp, QGuiApplication::palette().color(QPalette::AlternateBase));
+        }
+        if (hovered) {
+            painter->fillPath(pp, light ? QColor(0, 0, 0, 255 * 0.05) : QColor(255, 255, 255, 255 * 0.05));
+        }
+        if (selected) {
+            painter->fillPath(pp, light ? QColor(0, 0, 0, 51) : QColor(255, 255, 255, 51));
+        }
+
+        auto font = DFontSizeManager::instance()->get(DFontSizeManager::T6);
+        font.setWeight(playing ? QFont::Medium : QFont::Normal);
+        painter->setFont(font);
+
+        QColor tips = pal.color(DPalette::TextTips);
+        QColor hl = pal.color(DPalette::Highlight);
+
+        int x = rect.left() + 17;
+        painter->setPen(playing ? hl : tips);
+        painter->drawText(QRect(x, rect.top(), 22, rect.height()), Qt::AlignLeft | Qt::AlignVCenter,
+                          QString::number(index.row() + 1));
+        x += 22 + 10;
+
+        QRect thumbRect(x, rect.top() + (rect.height() - 24) / 2, 42, 24);
+        auto thumb = index.data(Qt::DecorationRole).value<QPixmap>();
+        if (!thumb.isNull()) {
+            QPainterPath tp;
+            tp.addRoundedRect(QRectF(thumbRect), 4, 4);
+            painter->save();
+            painter->setClipPath(tp);
+            painter->drawPixmap(thumbRect, thumb);
+            painter->restore();
+        }
+        x += 42 + 10;
+
+        int right = rect.right() - 10;
+        if (selected || hovered) {
+            auto cr = closeRect(rect);
+            DStyle::standardIcon(_view->style(), DStyle::SP_CloseButton).paint(painter, cr);
+            right = cr.left() - 10;
         } else {
-//            DPalette pa_name = DApplicationHelper::instance()->palette(_name);
-//            pa_name.setBrush(DPalette::Text, pa_name.color(DPalette::ToolTipText));
-//            _name->setPalette(pa_name);
-//            _name->setFontWeight(QFont::Weight::Normal);
-            _name->setForegroundRole(DPalette::ToolTipText);
-            _index->setForegroundRole(DPalette::TextTips);
-            _time->setForegroundRole(DPalette::TextTips);
-            DFontSizeManager::instance()->bind(_name, DFontSizeManager::T6, QFont::Normal);
-            DFontSizeManager::instance()->bind(_index, DFontSizeManager::T6, QFont::Normal);
-            DFontSizeManager::instance()->bind(_time, DFontSizeManager::T6, QFont::Normal);
+            QString time = valid ? index.data(PlaylistItemModel::DurationRole).toString()
+                           : QCoreApplication::translate("dmr::PlayItemWidget", "The file does not exist");
+            int tw = painter->fontMetrics().width(time);
+            painter->drawText(QRect(right - tw, rect.top(), tw, rect.height()),
+                              Qt::AlignRight | Qt::AlignVCenter, time);
+            right -= tw + 10;
         }
 
-        if (!_pif.valid) {
-            setState(ItemState::Invalid);
-            _name->setForegroundRole(DPalette::TextTips);
-            _time->setText(tr("The file does not exist"));
-        }
+        QColor text = pal.color(DPalette::ToolTipText);
+        painter->setPen(!valid ? tips : playing ? hl : text);
+        QRect nameRect(x, rect.top(), qMax(0, right - x), rect.height());
+        auto name = painter->fontMetrics().elidedText(index.data(Qt::DisplayRole).toString(),
+                                                      Qt::ElideRight, nameRect.width());
+        painter->drawText(nameRect, Qt::AlignLeft | Qt::AlignVCenter, name);
 
-        if (m_bIsSelect) {
+        painter->restore();
+    }
 
-            _time->hide();
-            _closeBtn->show();
-            _closeBtn->raise();
-            QColor bgColor(255, 255, 255, 51);
-            if (DGuiApplicationHelper::LightType == DGuiApplicationHelper::instance()->themeType() ) {
-                bgColor = QColor(0, 0, 0, 51);
+    bool editorEvent(QEvent *event, QAbstractItemModel *model, const QStyleOptionViewItem &option,
+                     const QModelIndex &index) override
+    {
+        if (event->type() == QEvent::MouseButtonRelease) {
+            auto *me = static_cast<QMouseEvent *>(event);
+            if (me->button() == Qt::LeftButton && closeRect(option.rect).contains(me->pos())) {
+                emit closeClicked(index.row());
+                return true;
             }
-
-            QPainterPath pp;
-            pp.addRoundedRect(bgRect, 8, 8);
-            painter.fillPath(pp, bgColor);
-
-        } else {
-            _time->show();
-            _closeBtn->hide();
         }
-
-        QWidget::paintEvent(pe);
+        return QStyledItemDelegate::editorEvent(event, model, option, index);
     }
 
+signals:
+    void closeClicked(int row);
+
 private:
-    QString _bg;
-    DLabel *_index;
-    ListPic *_thumb;
-    DLabel *_name;
-    DLabel *_time;
-    QPixmap _play;
-    PlayItemInfo _pif;
-    //FloatingButton *_closeBtn;
-    DFloatingButton *_closeBtn;
-    QListWidget *_listWidget {nullptr};
-    bool _hovered {false};
-    PlaylistWidget *_playlist{nullptr};
-    bool m_bIsSelect = false;
+    static QRect closeRect(const QRect &rect)
+    {
+        return QRect(rect.right() - 10 - 25, rect.top() + (rect.height() - 25) / 2, 25, 25);
+    }
+
+    QListView *_view {nullptr};
 };
 
 class MainWindowListener: public QObject
@@ -628,15 +463,11 @@ protected:
                 auto *plw = dynamic_cast<PlaylistWidget *>(parent());
 
                 if (plw->state() == PlaylistWidget::State::Opened) {
-                    DListWidget *playlist = plw->get_playlist();
-                    for (int loop = 0; loop < playlist->count(); loop++) {
-                        auto piw = dynamic_cast<PlayItemWidget *>(playlist->itemWidget(playlist->item(loop)));
-                        if (piw->getBIsSelect()) {
-                            piw->doubleClicked();
-                            return false;
-                        }
+                    QListView *playlist = plw->get_playlist();
+                    auto index = playlist->currentIndex();
+                    if (index.isValid() && playlist->selectionModel()->isSelected(index)) {
+                        plw->activateItem(index.row());
                     }
-
                 }
             }
             return false;
@@ -772,7 +603,7 @@ PlaylistWidget::PlaylistWidget(QWidget *mw, PlayerEngine *mpv)
     right->setContentsMargins(0, 0, 0, 0);
     mainLayout->addWidget(right);
 
-    _playlist = new DListWidget();
+    _playlist = new QListView();
     _playlist->setAttribute(Qt::WA_DeleteOnClose);
     _playlist->setFocusPolicy(Qt::NoFocus);
 //    _playlist->setFixedSize(820,288);
@@ -787,18 +618,37 @@ PlaylistWidget::PlaylistWidget(QWidget *mw, PlayerEngine *mpv)
     _playlist->setFrameShape(QFrame::NoFrame);
     _playlist->setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred));
 
-    _playlist->setSelectionMode(QListView::NoSelection);
+    _model = new PlaylistItemModel(&_engine->playlist(), this);
+    _delegate = new PlaylistItemDelegate(_playlist);
+    _playlist->setModel(_model);
+    _playlist->setItemDelegate(_delegate);
+    _playlist->setUniformItemSizes(true);
+    _playlist->setMouseTracking(true);
+    _playlist->viewport()->setAttribute(Qt::WA_Hover);
+
+    _playlist->setSelectionMode(QListView::SingleSelection);
     _playlist->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     _playlist->setResizeMode(QListView::Adjust);
     _playlist->setDragDropMode(QListView::InternalMove);
+    _playlist->setDefaultDropAction(Qt::MoveAction);
+    _playlist->setDropIndicatorShown(true);
     _playlist->setSpacing(0);
 
     //setAcceptDrops(true);
     _playlist->viewport()->setAcceptDrops(true);
     _playlist->setDragEnabled(true);
 
-    connect(_playlist, &DListWidget::itemClicked, this, &PlaylistWidget::slotShowSelectItem);
-    connect(_playlist, &DListWidget::currentItemChanged, this, &PlaylistWidget::OnItemChanged);
+    connect(_playlist, &QListView::clicked, this, &PlaylistWidget::slotShowSelectItem);
+    connect(_playlist, &QListView::doubleClicked, this, [ = ](const QModelIndex & index) {
+        activateItem(index.row());
+    });
+    connect(_delegate, &PlaylistItemDelegate::closeClicked, this, [ = ](int row) {
+        qDebug() << "item close clicked";
+        _clickedRow = row;
+        _mw->requestAction(ActionFactory::ActionKind::PlaylistRemoveItem);
+    });
+    connect(_playlist->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &PlaylistWidget::requestVisibleThumbnails);
 
     _playlist->setContentsMargins(0, 30, 0, 0);
 
@@ -812,85 +662,19 @@ PlaylistWidget::PlaylistWidget(QWidget *mw, PlayerEngine *mpv)
     mw->installEventFilter(mwl);
 #endif
 
-    if (!_closeMapper) {
-        _closeMapper = new QSignalMapper(this);
-        connect(_closeMapper,
-                static_cast<void(QSignalMapper::*)(QWidget *)>(&QSignalMapper::mapped),
-        [ = ](QWidget * w) {
-            qDebug() << "item close clicked";
-            _clickedItem = w;
-            _mw->requestAction(ActionFactory::ActionKind::PlaylistRemoveItem);
-        });
-    }
-
-    if (!_activateMapper) {
-        _activateMapper = new QSignalMapper(this);
-        connect(_activateMapper,
-                static_cast<void(QSignalMapper::*)(QWidget *)>(&QSignalMapper::mapped),
-        [ = ](QWidget * w) {
-            qDebug() << "item double clicked";
-            QList<QVariant> args;
-            for (int i = 0; i < _playlist->count(); i++) {
-                if (w == _playlist->itemWidget(_playlist->item(i))) {
-                    args << i;
-                    _mw->requestAction(ActionFactory::ActionKind::GotoPlaylistSelected,
-                                       false, args);
-
-                    QTimer *closelistTImer = new QTimer;
-                    closelistTImer->start(500);
-                    connect(closelistTImer, &QTimer::timeout, [ = ]() {
-                        closelistTImer->deleteLater();
-                        togglePopup();
-                        emit _mw->playlistchanged();
-                        _mw->reflectActionToUI(ActionFactory::TogglePlaylist);
-                    });
-                    //togglePopup();
-                    //emit _mw->playlistchanged();
-                    //_mw->reflectActionToUI(ActionFactory::TogglePlaylist);
-                    break;
-                }
-            }
-        });
-    }
-
-    connect(&_engine->playlist(), &PlaylistModel::emptied, this, &PlaylistWidget::clear);
-    connect(&_engine->playlist(), &PlaylistModel::itemsAppended, this, &PlaylistWidget::appendItems);
+    // rows themselves are kept in sync by _model, these only track view state
     connect(&_engine->playlist(), &PlaylistModel::itemRemoved, this, &PlaylistWidget::removeItem);
-    connect(&_engine->playlist(), &PlaylistModel::currentChanged, this, &PlaylistWidget::updateItemStates);
-    connect(&_engine->playlist(), &PlaylistModel::itemInfoUpdated, this, &PlaylistWidget::updateItemInfo);
+    connect(&_engine->playlist(), &PlaylistModel::currentChanged, this, &PlaylistWidget::updateItemStates,
+            Qt::QueuedConnection);
+    connect(_model, &QAbstractItemModel::rowsInserted, this, &PlaylistWidget::updateCount);
+    connect(_model, &QAbstractItemModel::rowsInserted, this, &PlaylistWidget::requestVisibleThumbnails);
+    connect(_model, &QAbstractItemModel::rowsRemoved, this, &PlaylistWidget::updateCount);
+    connect(_model, &QAbstractItemModel::modelReset, this, &PlaylistWidget::updateCount);
 
     QTimer::singleShot(10, this, &PlaylistWidget::loadPlaylist);
 
     connect(ActionFactory::get().playlistContextMenu(), &DMenu::aboutToShow, [ = ]() {
-        QTimer::singleShot(20, [ = ]() {
-            if (_mouseItem) {
-                _clickedItem = _mouseItem;
-                ((PlayItemWidget *)_mouseItem)->setHovered(true);
-            }
-        });
-    });
-    connect(ActionFactory::get().playlistContextMenu(), &DMenu::aboutToHide, [ = ]() {
-        if (_mouseItem) {
-            ((PlayItemWidget *)_mouseItem)->setHovered(false);
-        }
-    });
-
-    connect(_playlist->model(), &QAbstractItemModel::rowsMoved, [ = ]() {
-        if (_lastDragged.first >= 0) {
-            int target = -1;
-            for (int i = 0; i < _playlist->count(); i++) {
-                auto piw = dynamic_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(i)));
-                if (piw == _lastDragged.second) {
-                    target = i;
-                    break;
-                }
-            }
-            qDebug() << "swap " << _lastDragged.first << target;
-            if (target >= 0 && _lastDragged.first != target) {
-                _engine->playlist().switchPosition(_lastDragged.first, target);
-                _lastDragged = {-1, nullptr};
-            }
-        }
+        _clickedRow = _mouseRow;
     });
 }
 
@@ -898,15 +682,11 @@ PlaylistWidget::~PlaylistWidget()
 {
 }
 
+
 void PlaylistWidget::updateSelectItem(const int key)
 {
-    auto curItem = _playlist->currentItem();
-    auto curRow = _playlist->row(curItem);
+    int curRow = _playlist->currentIndex().row();
     qDebug() << "prevRow..." << curRow;
-    PlayItemWidget *prevItemWgt = nullptr;
-    if (curItem) {
-        prevItemWgt = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(curItem));
-    }
 
     if (key == Qt::Key_Up) {
         if (curRow == -1) {
@@ -917,130 +697,97 @@ void PlaylistWidget::updateSelectItem(const int key)
         if (_index < 0) {
             return;
         }
-
-        _playlist->setCurrentRow(_index);
         qDebug() << "Enter Key_Up..." << _index;
-        auto curItemWgt = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(_index)));
-        if (prevItemWgt) {
-            prevItemWgt->setBIsSelect(false);
-        }
-        if (curItemWgt) {
-            curItemWgt->setBIsSelect(true);
-        }
-
     } else if (key == Qt::Key_Down) {
-        if (_index >= _playlist->count() - 1) {
+        if (curRow >= _model->rowCount() - 1) {
             return;
         }
         _index = curRow + 1;
-        _playlist->setCurrentRow(_index);
         qDebug() << "Enter Key_Down..." << _index;
-        auto curItemWgt = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(_index)));
-        if (prevItemWgt) {
-            prevItemWgt->setBIsSelect(false);
-        }
-        if (curItemWgt) {
-            curItemWgt->setBIsSelect(true);
-        }
+    } else {
+        return;
     }
+
+    _playlist->setCurrentIndex(_model->index(_index));
 }
 
 void PlaylistWidget::clear()
 {
-    _playlist->clear();
-    QString s = QString(tr("%1 videos")).arg(_playlist->count());
-    _num->setText(s);
+    _model->reload();
 }
 
-
-void PlaylistWidget::updateItemInfo(int id)
+void PlaylistWidget::updateCount()
 {
-    auto piw = dynamic_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(id)));
-    piw->updateInfo(_engine->playlist().items()[id]);
+    QString s = QString(tr("%1 videos")).arg(_model->rowCount());
+    _num->setText(s);
 }
 
 void PlaylistWidget::updateItemStates()
 {
-    qDebug() << __func__ << _playlist->count() << "current = " << _engine->playlist().current();
-    for (int i = 0; i < _playlist->count(); i++) {
-        auto piw = dynamic_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(i)));
-
-        auto old = piw->state();
-        piw->setState(ItemState::Normal);
-        if (!piw->_pif.valid) {
-            piw->setState(ItemState::Invalid);
-        }
-
-        if (i == _engine->playlist().current()) {
-            if (piw->state() != ItemState::Playing) {
-                _playlist->scrollToItem(_playlist->item(i));
-                piw->setState(ItemState::Playing);
-            }
-        }
-
-        if (old != piw->state()) {
-//            piw->setStyleSheet(piw->styleSheet());
-        }
+    int cur = _engine->playlist().current();
+    qDebug() << __func__ << _model->rowCount() << "current = " << cur;
+    if (cur >= 0 && cur < _model->rowCount()) {
+        _playlist->scrollTo(_model->index(cur));
     }
-
 }
 
 void PlaylistWidget::showItemInfo()
 {
-    if (!_mouseItem) return;
-    auto item = dynamic_cast<PlayItemWidget *>(_mouseItem);
-    if (item) {
-        MovieInfoDialog mid(item->_pif);
-        mid.exec();
-    }
+    if (_mouseRow < 0 || _mouseRow >= _model->rowCount()) return;
+    MovieInfoDialog mid(_engine->playlist().items().at(_mouseRow));
+    mid.exec();
 }
 
 void PlaylistWidget::openItemInFM()
 {
-    if (!_mouseItem) return;
-    auto item = dynamic_cast<PlayItemWidget *>(_mouseItem);
-    if (item) {
-        utils::ShowInFileManager(item->_pif.mi.filePath);
-    }
+    if (_mouseRow < 0 || _mouseRow >= _model->rowCount()) return;
+    utils::ShowInFileManager(_engine->playlist().items().movieInfo(_mouseRow).filePath);
 }
 
 void PlaylistWidget::removeClickedItem(bool isShortcut)
 {
     if (isShortcut) {
-        for (int i = 0; i < _playlist->count(); i++) {
-            auto piw = dynamic_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(i)));
-            qDebug() << piw->getBIsSelect();
-            if (piw->getBIsSelect()) {
-                _engine->playlist().remove(i);
-            }
+        auto index = _playlist->currentIndex();
+        if (index.isValid() && _playlist->selectionModel()->isSelected(index)) {
+            _engine->playlist().remove(index.row());
         }
+        return;
     }
 
-    if (!_clickedItem) return;
-    auto piw = dynamic_cast<PlayItemWidget *>(_clickedItem);
-    if (piw) {
-        qDebug() << __func__;
-        for (int i = 0; i < _playlist->count(); i++) {
-            if (_clickedItem == _playlist->itemWidget(_playlist->item(i))) {
-                _engine->playlist().remove(i);
-                break;
-            }
-        }
-    }
+    if (_clickedRow < 0 || _clickedRow >= _model->rowCount()) return;
+    qDebug() << __func__ << _clickedRow;
+    int row = _clickedRow;
+    _clickedRow = -1;
+    _engine->playlist().remove(row);
 }
 
-void PlaylistWidget::dragEnterEvent(QDragEnterEvent *ev)
+void PlaylistWidget::activateItem(int row)
 {
-    auto md = ev->mimeData();
-    qDebug() << md->formats();
-    if (md->formats().contains("application/x-qabstractitemmodeldatalist")) {
-        if (!_playlist->selectedItems().contains(_playlist->itemAt(ev->pos()))) {
-            _playlist->setDropIndicatorShown(true);
-        }
-        QWidget::dragEnterEvent(ev);
+    if (row < 0 || row >= _model->rowCount()) return;
+
+    //FIXME: validity shown in the row is only refreshed once the item gets played
+    const QUrl &url = _engine->playlist().items().url(row);
+    if (url.isLocalFile() && !QFileInfo::exists(url.toLocalFile())) {
         return;
     }
 
+    qDebug() << "item double clicked";
+    QList<QVariant> args;
+    args << row;
+    _mw->requestAction(ActionFactory::ActionKind::GotoPlaylistSelected, false, args);
+
+    QTimer *closelistTImer = new QTimer;
+    closelistTImer->start(500);
+    connect(closelistTImer, &QTimer::timeout, [ = ]() {
+        closelistTImer->deleteLater();
+        togglePopup();
+        emit _mw->playlistchanged();
+        _mw->reflectActionToUI(ActionFactory::TogglePlaylist);
+    });
+}
+
+void PlaylistWidget::dragEnterEvent(QDragEnterEvent *ev)
+{
     if (ev->mimeData()->hasUrls()) {
         ev->acceptProposedAction();
     }
@@ -1048,15 +795,6 @@ void PlaylistWidget::dragEnterEvent(QDragEnterEvent *ev)
 
 void PlaylistWidget::dragMoveEvent(QDragMoveEvent *ev)
 {
-    auto md = ev->mimeData();
-    if (md->formats().contains("application/x-qabstractitemmodeldatalist")) {
-        if (!_playlist->selectedItems().contains(_playlist->itemAt(ev->pos()))) {
-            _playlist->setDropIndicatorShown(true);
-        }
-        QWidget::dragMoveEvent(ev);
-        return;
-    }
-
     if (ev->mimeData()->hasUrls()) {
         ev->acceptProposedAction();
     }
@@ -1064,26 +802,7 @@ void PlaylistWidget::dragMoveEvent(QDragMoveEvent *ev)
 
 void PlaylistWidget::dropEvent(QDropEvent *ev)
 {
-    auto md = ev->mimeData();
-    if (md->formats().contains("application/x-qabstractitemmodeldatalist")) {
-        _playlist->setDropIndicatorShown(false);
-        auto encoded = md->data("application/x-qabstractitemmodeldatalist");
-        QDataStream stream(&encoded, QIODevice::ReadOnly);
-
-        QList<int> l;
-        while (!stream.atEnd()) {
-            int row, col;
-            QMap<int,  QVariant> roleDataMap;
-            stream >> row >> col >> roleDataMap;
-            auto piw = dynamic_cast<PlayItemWidget *>(_playlist->itemWidget(_playlist->item(row)));
-            _lastDragged = qMakePair(row, piw);
-            qDebug() << "drag to move " << row << piw->_pif.url;
-        }
-
-        QWidget::dropEvent(ev);
-        return;
-    }
-
+    // moves inside the list are handled by the view and PlaylistItemModel
     if (!ev->mimeData()->hasUrls()) {
         return;
     }
@@ -1096,28 +815,23 @@ void PlaylistWidget::dropEvent(QDropEvent *ev)
 
 void PlaylistWidget::contextMenuEvent(QContextMenuEvent *cme)
 {
-    bool on_item = false;
-    _mouseItem = nullptr;
-    QPoint itempos(cme->pos().x() - 235, cme->pos().y() - 30);
-
-    if (_playlist->itemAt(itempos)) {
-        _mouseItem = _playlist->itemWidget(_playlist->itemAt(itempos));
-        on_item = true;
-    }
+    auto index = _playlist->indexAt(_playlist->viewport()->mapFrom(this, cme->pos()));
+    _mouseRow = index.isValid() ? index.row() : -1;
+    bool on_item = _mouseRow >= 0;
 
-    auto piw = dynamic_cast<PlayItemWidget *>(_mouseItem);
+    const auto &items = _engine->playlist().items();
     auto menu = ActionFactory::get().playlistContextMenu();
     for (auto act : menu->actions()) {
         auto prop = (ActionFactory::ActionKind)act->property("kind").toInt();
         bool on = true;
         if (prop == ActionFactory::ActionKind::PlaylistOpenItemInFM) {
-            on = on_item && piw->_pif.valid && piw->_pif.url.isLocalFile();
+            on = on_item && items.isValid(_mouseRow) && items.url(_mouseRow).isLocalFile();
         } else if (prop == ActionFactory::ActionKind::PlaylistRemoveItem) {
             on = on_item;
         } else if (prop == ActionFactory::ActionKind::PlaylistItemInfo) {
-            on = on_item && piw->_pif.valid;
+            on = on_item && items.isValid(_mouseRow);
         } else {
-            on = _playlist->count() > 0 ? true : false;
+            on = _model->rowCount() > 0 ? true : false;
         }
         act->setEnabled(on);
     }
@@ -1127,147 +841,52 @@ void PlaylistWidget::contextMenuEvent(QContextMenuEvent *cme)
 
 void PlaylistWidget::showEvent(QShowEvent *se)
 {
-    batchUpdateSizeHints();
     adjustSize();
+    requestVisibleThumbnails();
 }
 
-void PlaylistWidget::removeItem(int idx)
+void PlaylistWidget::requestVisibleThumbnails()
 {
-    qDebug() << "idx = " << idx;
-    auto item = this->_playlist->takeItem(idx);
-    if (item) {
-        delete item;
-    }
+    if (!isVisible() || !_model->rowCount()) return;
 
-    this->_playlist->update();
-    for (int i = 0; i < _playlist->count(); i++) {
-        QWidget *item = _playlist->itemWidget(_playlist->item(i));
-        if (item) {
-            (dynamic_cast<PlayItemWidget *>(item))->setIndex(i);
-        }
-    }
+    auto rect = _playlist->viewport()->rect();
+    int first = _playlist->indexAt(rect.topLeft()).row();
+    int last = _playlist->indexAt(rect.bottomLeft()).row();
+    if (first < 0) first = 0;
+    if (last < 0) last = _model->rowCount() - 1;
 
-    if (_playlist->count() != 0 && _playlist->count() != idx) {
-        QWidget *item = _playlist->itemWidget(_playlist->item(idx));
-        PlayItemWidget *curItem = dynamic_cast<PlayItemWidget *>(item);
-        curItem->setCurItemHovered(true);
-    } else if (_playlist->count() != 0 && _playlist->count() == idx) {
-        QWidget *item = _playlist->itemWidget(_playlist->item(--idx));
-        PlayItemWidget *curItem = dynamic_cast<PlayItemWidget *>(item);
-        curItem->setCurItemHovered(true);
+    QList<int> ids;
+    for (int i = first; i <= last; i++) {
+        ids.append(i);
     }
-
-    QString s = QString(tr("%1 videos")).arg(_playlist->count());
-    _num->setText(s);
+    _engine->playlist().requestThumbnails(ids);
 }
 
-void PlaylistWidget::appendItems()
+void PlaylistWidget::removeItem(int idx)
 {
-    qDebug() << __func__;
-
-    auto items = _engine->playlist().items();
-    auto p = items.begin() + this->_playlist->count();
-    while (p != items.end()) {
-        auto w = new PlayItemWidget(*p, this->_playlist, p - items.begin(), this);
-
-        auto item = new QListWidgetItem;
-        item->setFlags(Qt::NoItemFlags);
-        _playlist->addItem(item);
-        _playlist->setItemWidget(item, w);
-
-        connect(w, SIGNAL(closeButtonClicked()), _closeMapper, SLOT(map()));
-        connect(w, SIGNAL(doubleClicked()), _activateMapper, SLOT(map()));
-        _closeMapper->setMapping(w, w);
-        _activateMapper->setMapping(w, w);
-        ++p;
+    qDebug() << "idx = " << idx;
+    if (_mouseRow == idx) {
+        _mouseRow = -1;
+    } else if (_mouseRow > idx) {
+        _mouseRow--;
     }
-    QString s = QString(tr("%1 videos")).arg(_playlist->count());
-    _num->setText(s);
-    batchUpdateSizeHints();
-    updateItemStates();
-//    _playlist->setStyleSheet(styleSheet());
-//    setStyleSheet(styleSheet());
-}
-
-void PlaylistWidget::slotShowSelectItem(QListWidgetItem *item)
-{
-//    auto curItem = _playlist->currentItem();
-//    if (curItem) {
-//        auto itemWidget = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(curItem));
-//        if (itemWidget) {
-//            itemWidget->setBIsSelect(false);
-//        }
-//    }
-
-    if (item) {
-        _playlist->setCurrentItem(item);
-        auto pWidget = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(item));
-        if (pWidget) {
-            pWidget->setBIsSelect(true);
-        }
+    if (_clickedRow > idx) {
+        _clickedRow--;
     }
 }
 
-void PlaylistWidget::OnItemChanged(QListWidgetItem *current, QListWidgetItem *previous)
+void PlaylistWidget::slotShowSelectItem(const QModelIndex &index)
 {
-    auto prevRow = _playlist->row(previous);
-    qDebug() << "changed prevRow..." << prevRow;
-    if (previous) {
-        auto prevItemWgt = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(previous));
-        if (prevItemWgt) {
-            prevItemWgt->setBIsSelect(false);
-        }
-    }
-
-    if (current) {
-        qDebug() << "changed curRow..." << _playlist->row(current);
-        auto curItemWgt = reinterpret_cast<PlayItemWidget *>(_playlist->itemWidget(current));
-        if (curItemWgt) {
-            curItemWgt->setBIsSelect(true);
-        }
+    if (index.isValid()) {
+        _playlist->setCurrentIndex(index);
     }
 }
 
 void PlaylistWidget::loadPlaylist()
 {
     qDebug() << __func__;
-    _playlist->clear();
-
-
-    auto items = _engine->playlist().items();
-    auto p = items.begin();
-    while (p != items.end()) {
-        auto w = new PlayItemWidget(*p, this->_playlist, p - items.begin(), this);
-        auto item = new QListWidgetItem;
-        item->setFlags(Qt::NoItemFlags);
-        _playlist->addItem(item);
-        _playlist->setItemWidget(item, w);
-
-        connect(w, SIGNAL(closeButtonClicked()), _closeMapper, SLOT(map()));
-        connect(w, SIGNAL(doubleClicked()), _activateMapper, SLOT(map()));
-        _closeMapper->setMapping(w, w);
-        _activateMapper->setMapping(w, w);
-        ++p;
-    }
-
-    batchUpdateSizeHints();
+    _model->reload();
     updateItemStates();
-//    _playlist->setStyleSheet(styleSheet());
-    QString s = QString(tr("%1 videos")).arg(_playlist->count());
-    _num->setText(s);
-//    setStyleSheet(styleSheet());
-}
-
-void PlaylistWidget::batchUpdateSizeHints()
-{
-    if (isVisible()) {
-        for (int i = 0; i < this->_playlist->count(); i++) {
-            auto item = this->_playlist->item(i);
-            auto w = this->_playlist->itemWidget(item);
-            auto t = w->size();
-            item->setSizeHint(w->size());
-        }
-    }
 }
 
 void PlaylistWidget::endAnimation()
@@ -1391,8 +1010,6 @@ void PlaylistWidget::resizeEvent(QResizeEvent *ev)
 //    _playlist->setFixedWidth(width() - 235);
     _playlist->setFixedWidth(fixed.width() - 235);
     emit sizeChange();
-
-    QTimer::singleShot(100, this, &PlaylistWidget::batchUpdateSizeHints);
 }
 
 }
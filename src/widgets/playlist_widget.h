@@ -35,7 +35,6 @@
 #include <QtWidgets>
 #include <DIconButton>
 #include <DFloatingButton>
-#include <DListWidget>
 #include <DApplicationHelper>
 #include <DFontSizeManager>
 #include <QBrush>
@@ -65,6 +64,11 @@ public:
         setFixedSize(QSize(42, 24));
         _pic = pic;
     }
+    void setPic(QPixmap pic)
+    {
+        _pic = pic;
+        update();
+    }
 protected:
     void paintEvent(QPaintEvent *pe) override
     {
@@ -102,7 +106,8 @@ signals:
     void mouseHover(bool bFlag);
 };
 
-class PlayItemWidget;
+class PlaylistItemModel;
+class PlaylistItemDelegate;
 
 class PlaylistWidget: public QWidget
 {
@@ -124,7 +129,7 @@ public:
     }
     void updateSelectItem(const int key);
     void clear();
-    DListWidget *get_playlist()
+    QListView *get_playlist()
     {
         return _playlist;
     }
@@ -138,6 +143,7 @@ public slots:
     void openItemInFM();
     void showItemInfo();
     void removeClickedItem(bool isShortcut);
+    void activateItem(int row);
 
 protected:
     void contextMenuEvent(QContextMenuEvent *cme) override;
@@ -150,31 +156,26 @@ protected:
 
 protected slots:
     void updateItemStates();
-    void updateItemInfo(int);
-    void appendItems();
+    void updateCount();
     void removeItem(int);
 
-    void slotShowSelectItem(QListWidgetItem *);
-    void OnItemChanged(QListWidgetItem *current, QListWidgetItem *previous);
+    void slotShowSelectItem(const QModelIndex &);
+    void requestVisibleThumbnails();
 
 private:
 
     PlayerEngine *_engine {nullptr};
     MainWindow *_mw {nullptr};
-    QWidget *_mouseItem {nullptr};
-    QWidget *_clickedItem {nullptr};
-    QSignalMapper *_closeMapper {nullptr};
-    QSignalMapper *_activateMapper {nullptr};
-    DListWidget *_playlist {nullptr};
+    int _mouseRow {-1};
+    int _clickedRow {-1};
+    PlaylistItemModel *_model {nullptr};
+    PlaylistItemDelegate *_delegate {nullptr};
+    QListView *_playlist {nullptr};
     State _state {Closed};
     DLabel *_num {nullptr};
     DLabel *_title {nullptr};
     bool _toggling {false};
-    /// < original row, data>
-    QPair<int, PlayItemWidget *> _lastDragged {-1, nullptr};
     int _index {0};
-    PlayItemWidget *_selectItemWgt;
-    void batchUpdateSizeHints();
 
     QPropertyAnimation *paOpen ;
     QPropertyAnimation *paClose ;
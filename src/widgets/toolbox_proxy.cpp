@@ -39,6 +39,9 @@
 #include "actions.h"
 #include "slider.h"
 #include "thumbnail_worker.h"
+#include "frame_grabber.h"
+#include "persistent_manager.h"
+#include "playback_clock.h"
 #include "tip.h"
 #include "utils.h"
 
@@ -55,11 +58,29 @@ static const int PROGBAR_SPEC = 10 + 120 + 17 + 54 + 10 + 54 + 10 + 170 + 10 + 2
 
 static const QString SLIDER_ARROW = ":resources/icons/slider.svg";
 
+// film strips are cached with this many slices whatever the bar width is
+static const int CACHED_STRIP_SLICES = 160;
+
 #define POPUP_DURATION 350
 
 DWIDGET_USE_NAMESPACE
 
 namespace dmr {
+// picks, for each of the to slices, the one of the from slices of strip
+// closest in time, slice i sits at (i + 1) / count of the movie
+static QImage resampleStrip(const QImage &strip, int from, int to)
+{
+    if (from == to) return strip;
+
+    QImage out(to * 8, strip.height(), strip.format());
+    QPainter p(&out);
+    for (int i = 0; i < to; i++) {
+        int j = qBound(0, qRound((i + 1) * qreal(from) / to) - 1, from - 1);
+        p.drawImage(i * 8, 0, strip, j * 8, 0, 8, strip.height());
+    }
+    return out;
+}
+
 class KeyPressBubbler: public QObject
 {
 public:
@@ -676,20 +697,26 @@ public:
 //            ImageItem *label = new ImageItem(pm_list.at(i));
 //            label->setFixedSize(8,50);
 //            _viewProgBarLayout->addWidget(label, 0 , Qt::AlignLeft );
-            ImageItem *label = new ImageItem(pm_list.at(i), false, _back);
-            label->setMouseTracking(true);
-            label->move(i * 9 + 3, 5);
-            label->setFixedSize(8, 50);
-
-            ImageItem *label_black = new ImageItem(pm_black_list.at(i), true, _front);
-            label_black->setMouseTracking(true);
-            label_black->move(i * 9 + 3, 5);
-            label_black->setFixedSize(8, 50);
+            setSlice(i, pm_list.at(i), pm_black_list.at(i));
         }
 
         update();
 
 
+    }
+    void setSlice(int i, const QPixmap &pm, const QPixmap &pm_black)
+    {
+        ImageItem *label = new ImageItem(pm, false, _back);
+        label->setMouseTracking(true);
+        label->move(i * 9 + 3, 5);
+        label->setFixedSize(8, 50);
+        label->show();
+
+        ImageItem *label_black = new ImageItem(pm_black, true, _front);
+        label_black->setMouseTracking(true);
+        label_black->move(i * 9 + 3, 5);
+        label_black->setFixedSize(8, 50);
+        label_black->show();
     }
     void setWidth()
     {
@@ -1191,11 +1218,32 @@ viewProgBarLoad::viewProgBarLoad(PlayerEngine *engine, DMRSlider *progBar, Toolb
     _parent = parent;
     _engine = engine;
     _progBar = progBar;
+
+    // everything about the engine is read here, in the gui thread
+    _size = parent->size();
+    _duration = _engine->duration() * 1000;
+    _width = _progBar->width();
+    _sliceCount = sliceCount(_width);
+    _url = _engine->playlist().currentInfo().url;
+    _file = QFileInfo(_url.toLocalFile()).absoluteFilePath();
+
+    _pool.setMaxThreadCount(qMax(1, qMin(QThread::idealThreadCount(), _sliceCount)));
+}
+
+int viewProgBarLoad::sliceCount(int width)
+{
+    return qCeil(qreal(width) / 9);
+}
+
+void viewProgBarLoad::cancel()
+{
+    _cancel.store(1);
+    requestInterruption();
 }
 
 void viewProgBarLoad::run()
 {
-    loadViewProgBar(_parent->size());
+    loadViewProgBar(_size);
 }
 
 void viewProgBarLoad::loadViewProgBar(QSize size)
@@ -1206,55 +1254,77 @@ void viewProgBarLoad::loadViewProgBar(QSize size)
         return;
     }
     isLoad = true;
-    auto num = qreal(_progBar->width()) / 9;
-    auto tmp = (_engine->duration() * 1000) / num;
-    auto dpr = qApp->devicePixelRatio();
-    QList<QPixmap> pm;
-//    pm.setDevicePixelRatio(dpr);
-    QList<QPixmap> pm_black;
-//    pm_black.setDevicePixelRatio(dpr);
-    VideoThumbnailer thumber;
-    QTime d(0, 0, 0, 0);
-    qDebug() << _engine->videoSize().width();
-    qDebug() << _engine->videoSize().height();
-    qDebug() << qApp->devicePixelRatio();
-    if (_engine->videoSize().width() > 0 && _engine->videoSize().height() > 0) {
-        thumber.setThumbnailSize(50 * (_engine->videoSize().width() / _engine->videoSize().height() * 50)
-                                 * qApp->devicePixelRatio());
-    }
-
-    thumber.setMaintainAspectRatio(true);
-    thumber.setSeekTime(d.toString("hh:mm:ss").toStdString());
-    auto url = _engine->playlist().currentInfo().url;
-    auto file = QFileInfo(url.toLocalFile()).absoluteFilePath();
-
-    for (auto i = 0; i < num; i++) {
-        if (isInterruptionRequested()) {
-            qDebug() << "isInterruptionRequested";
-            return;
-        }
-        d = d.addMSecs(tmp);
-//        qDebug()<<d;
-        thumber.setSeekTime(d.toString("hh:mm:ss:ms").toStdString());
-        try {
-            std::vector<uint8_t> buf;
-            thumber.generateThumbnail(file.toUtf8().toStdString(), ThumbnailerImageType::Jpeg, buf);
 
-            auto img = QImage::fromData(buf.data(), buf.size(), "jpg");
-            auto img_tmp = img.scaledToHeight(50);
+    if (_sliceCount <= 0 || _duration <= 0) {
+        emit finished();
+        return;
+    }
+
+    auto step = _duration / (qreal(_width) / 9);
+    int workers = _pool.maxThreadCount();
+    _slices.resize(_sliceCount);
 
+    // worker w takes slices w, w + workers, ... so every decoder only seeks
+    // forward and the strip fills up evenly
+    QList<QFuture<void>> futures;
+    for (int w = 0; w < workers; w++) {
+        futures << QtConcurrent::run(&_pool, [ = ]() {
+            FrameGrabber grabber;
+            grabber.setCancelFlag(&_cancel);
+            if (!grabber.open(_file) || grabber.frameSize().isEmpty()) {
+                return;
+            }
 
-            pm.append(QPixmap::fromImage(img_tmp.copy(img_tmp.size().width() / 2 - 4, 0, 8, 50)));
-            QImage img_black = img_tmp.convertToFormat(QImage::Format_Grayscale8);
-            pm_black.append(QPixmap::fromImage(img_black.copy(img_black.size().width() / 2 - 4, 0, 8, 50)));
+            auto fs = grabber.frameSize();
+            QSize sz(qMax(8, fs.width() * 50 / fs.height()), 50);
+            for (int i = w; i < _sliceCount && !_cancel.load(); i += workers) {
+                // slices are 8px wide, the closest keyframe is as good
+                auto ms = grabber.nearestKeyframe(qint64(step * (i + 1)));
+                auto img = grabber.grab(ms, sz, Qt::IgnoreAspectRatio);
+                if (img.isNull()) {
+                    continue;
+                }
 
-        } catch (const std::logic_error &) {
-        }
+                auto slice = img.copy(img.width() / 2 - 4, 0, 8, 50);
+                emit sliceReady(i, slice, slice.convertToFormat(QImage::Format_Grayscale8));
 
+                QMutexLocker lock(&_slicesLock);
+                _slices[i] = slice;
+            }
+        });
+    }
+
+    for (auto &f : futures) {
+        f.waitForFinished();
+    }
+
+    if (_cancel.load()) {
+        qDebug() << "isInterruptionRequested";
+        return;
     }
-    _parent->addpm_list(pm);
-    _parent->addpm_black_list(pm_black);
+
     emit sigFinishiLoad(size);
+
+    // a strip with holes (or none at all when the file can't be opened)
+    // would be served from the cache from now on
+    for (const auto &slice : _slices) {
+        if (slice.isNull()) {
+            qDebug() << "film strip incomplete, not cached";
+            emit finished();
+            return;
+        }
+    }
+
+    // colour slices only, the grey ones are derived when loaded
+    QImage strip(_sliceCount * 8, 50, QImage::Format_RGB32);
+    {
+        QPainter p(&strip);
+        for (int i = 0; i < _slices.size(); i++) {
+            p.drawImage(i * 8, 0, _slices[i]);
+        }
+    }
+    PersistentManager::get().saveFilmStrip(_url, CACHED_STRIP_SLICES,
+                                           resampleStrip(strip, _sliceCount, CACHED_STRIP_SLICES));
     emit finished();
 
 
@@ -1344,8 +1414,7 @@ void ToolboxProxy::finishLoadSlot(QSize size)
 {
     if (pm_list.isEmpty()) return;
 
-    _viewProgBar->setViewProgBar(_engine, pm_list, pm_black_list);
-
+    // slices are already in place, see addThumbnailSlice
     if (CompositingManager::get().composited() && _loadsize == size && _engine->state() != PlayerEngine::CoreState::Idle) {
         PlayItemInfo info = _engine->playlist().currentInfo();
         if (!info.url.isLocalFile()) {
@@ -1368,6 +1437,7 @@ void ToolboxProxy::updateplaylisticon()
 }
 ToolboxProxy::~ToolboxProxy()
 {
+    cancelThumbnailLoad();
     ThumbnailWorker::get().stop();
 //    _loadThread->exit();
 //    _loadThread->terminate();
@@ -1782,25 +1852,23 @@ void ToolboxProxy::setup()
         _loadsize = size();
         update();
 //        updateThumbnail();
-    });
-    connect(_engine, &PlayerEngine::elapsedChanged, [ = ]() {
-        quint64 url = -1;
-        if (_engine->playlist().current() != -1) {
-            url = _engine->playlist().items()[_engine->playlist().current()].mi.duration;
+        if (!_engine->isAudioFile(_engine->playlist().currentInfo().info.fileName())) {
+            loadCachedThumbnail();
         }
-        updateTimeInfo(url, _engine->elapsed(), _timeLabel, _timeLabelend, true);
-        updateMovieProgress();
     });
-    connect(_engine, &PlayerEngine::elapsedChanged, [ = ]() {
-        quint64 _url = -1;
-        if (_engine->playlist().current() != -1) {
-            _url = _engine->playlist().items()[_engine->playlist().current()].mi.duration;
-        }
-        updateTimeInfo(_url, _engine->elapsed(), _fullscreentimelable, _fullscreentimelableend, false);
+    // labels only change once per second, the bar follows the display
+    auto &clock = _engine->clock();
+    clock.subscribe(_timeLabel, PlaybackClock::LabelRate, [ = ](const PlaybackClock::Snapshot & s) {
+        updateTimeInfo(s.itemDuration, s.elapsed, _timeLabel, _timeLabelend, true);
+    });
+    clock.subscribe(_fullscreentimelable, PlaybackClock::LabelRate, [ = ](const PlaybackClock::Snapshot & s) {
+        updateTimeInfo(s.itemDuration, s.elapsed, _fullscreentimelable, _fullscreentimelableend, false);
         QFontMetrics fm(DFontSizeManager::instance()->get(DFontSizeManager::T6));
         _fullscreentimelable->setMinimumWidth(fm.width(_fullscreentimelable->text()));
         _fullscreentimelableend->setMinimumWidth(fm.width(_fullscreentimelableend->text()));
-        updateMovieProgress();
+    });
+    clock.subscribe(_progBar_Widget, PlaybackClock::DisplaySync, [ = ](const PlaybackClock::Snapshot & s) {
+        updateMovieProgress(s);
     });
 
     connect(window()->windowHandle(), &QWindow::windowStateChanged, this, &ToolboxProxy::updateFullState);
@@ -1844,20 +1912,73 @@ void ToolboxProxy::setup()
     });
     PlaylistModel *playListModel = _engine->getplaylist();
     connect(playListModel, &PlaylistModel::currentChanged, this, [ = ] {
+        cancelThumbnailLoad();
         _autoResizeTimer.start(1000);
     });
 }
 
-void ToolboxProxy::updateThumbnail()
+void ToolboxProxy::cancelThumbnailLoad()
 {
+    m_workerSerial++;
     if (m_worker) {
         qDebug() << "kill last worker";
-        m_worker->requestInterruption();
+        m_worker->cancel();
         m_worker->quit();
         m_worker->wait();
         delete m_worker;
         m_worker = nullptr;
     }
+}
+
+bool ToolboxProxy::loadCachedThumbnail()
+{
+    const auto &pif = _engine->playlist().currentInfo();
+    if (!pif.url.isLocalFile()) {
+        return false;
+    }
+
+    int count = viewProgBarLoad::sliceCount(_progBar->width());
+    auto strip = PersistentManager::get().loadFilmStrip(pif.url, CACHED_STRIP_SLICES);
+    if (strip.isNull() || strip.width() < CACHED_STRIP_SLICES * 8) {
+        return false;
+    }
+
+    strip = resampleStrip(strip, CACHED_STRIP_SLICES, count);
+    auto strip_black = strip.convertToFormat(QImage::Format_Grayscale8);
+    pm_list.clear();
+    pm_black_list.clear();
+    for (int i = 0; i < count; i++) {
+        pm_list.append(QPixmap::fromImage(strip.copy(i * 8, 0, 8, 50)));
+        pm_black_list.append(QPixmap::fromImage(strip_black.copy(i * 8, 0, 8, 50)));
+    }
+
+    qDebug() << "film strip of" << pif.url.fileName() << "from cache";
+    _viewProgBar->clear();
+    _viewProgBar->setViewProgBar(_engine, pm_list, pm_black_list);
+    _loadsize = size();
+    finishLoadSlot(_loadsize);
+    return true;
+}
+
+void ToolboxProxy::addThumbnailSlice(int index, const QImage &img, const QImage &img_black)
+{
+    while (pm_list.size() <= index) {
+        pm_list.append(QPixmap());
+        pm_black_list.append(QPixmap());
+    }
+    pm_list[index] = QPixmap::fromImage(img);
+    pm_black_list[index] = QPixmap::fromImage(img_black);
+    _viewProgBar->setSlice(index, pm_list[index], pm_black_list[index]);
+
+    // show the strip with its first slice and let the rest stream in
+    if (_progBar_Widget->currentIndex() != 2) {
+        finishLoadSlot(_loadsize);
+    }
+}
+
+void ToolboxProxy::updateThumbnail()
+{
+    cancelThumbnailLoad();
 
     //如果打开的是音乐
     QString suffix = _engine->playlist().currentInfo().info.suffix();
@@ -1867,16 +1988,26 @@ void ToolboxProxy::updateThumbnail()
         }
     }
 
+    if (loadCachedThumbnail()) {
+        return;
+    }
+
     qDebug() << "worker" << m_worker;
 
-    QTimer::singleShot(1000, [this]() {
+    int serial = m_workerSerial;
+    QTimer::singleShot(1000, this, [ = ]() {
+        if (serial != m_workerSerial) {
+            return;
+        }
+
         pm_list.clear();
         pm_black_list.clear();
+        _viewProgBar->clear();
 
         m_worker = new viewProgBarLoad(_engine, _progBar, this);
 
         connect(m_worker, &viewProgBarLoad::finished, this, [ = ] {
-            if (m_worker)
+            if (m_worker && serial == m_workerSerial)
             {
                 m_worker->quit();
                 m_worker->wait();
@@ -1884,6 +2015,12 @@ void ToolboxProxy::updateThumbnail()
                 m_worker = nullptr;
             }
         });
+        connect(m_worker, &viewProgBarLoad::sliceReady, this,
+        [ = ](int index, const QImage & img, const QImage & img_black) {
+            if (serial == m_workerSerial) {
+                addThumbnailSlice(index, img, img_black);
+            }
+        });
         connect(m_worker, SIGNAL(sigFinishiLoad(QSize)), this, SLOT(finishLoadSlot(QSize)));
         m_worker->start();
         _progBar_Widget->setCurrentIndex(1);
@@ -2027,8 +2164,13 @@ void ToolboxProxy::updateTimeVisible(bool visible)
 
 void ToolboxProxy::updateMovieProgress()
 {
-    auto d = _engine->duration();
-    auto e = _engine->elapsed();
+    updateMovieProgress(_engine->clock().snapshot());
+}
+
+void ToolboxProxy::updateMovieProgress(const PlaybackClock::Snapshot &s)
+{
+    auto d = s.duration;
+    auto e = s.elapsed;
     int v = 0;
     int v2 = 0;
     if (d != 0 && e != 0) {
@@ -2435,6 +2577,7 @@ void ToolboxProxy::resizeEvent(QResizeEvent *event)
         _autoResizeTimer.stop();
     }
     if (event->oldSize().width() != event->size().width()) {
+        cancelThumbnailLoad();
         _autoResizeTimer.start(1000);
         _oldsize = event->size();
 //        _progBar->setFixedWidth(width() - PROGBAR_SPEC);
@@ -45,6 +45,7 @@
 #include <DFloatingWidget>
 #include "dguiapplicationhelper.h"
 #include "videoboxbutton.h"
+#include "playback_clock.h"
 
 namespace Dtk {
 namespace Widget {
@@ -158,6 +159,7 @@ protected slots:
     void updateFullState();
     void updateVolumeState();
     void updateMovieProgress();
+    void updateMovieProgress(const PlaybackClock::Snapshot &s);
     void updateButtonStates();
     void setProgress(int v);
     void updateTimeVisible(bool visible);
@@ -175,6 +177,9 @@ private:
     void updateTimeLabel();
     void updateToolTipTheme(ToolButton *btn);
     void updateThumbnail();
+    void cancelThumbnailLoad();
+    bool loadCachedThumbnail();
+    void addThumbnailSlice(int index, const QImage &img, const QImage &img_black);
     void updatePreviewTime(qint64 secs, const QPoint &pos);
 
     QLabel *_fullscreentimelable {nullptr};
@@ -232,6 +237,8 @@ private:
     QList<QPixmap >pm_black_list ;
 
     viewProgBarLoad *m_worker = nullptr;
+    // bumped on every cancel, slices of an older worker are dropped
+    int m_workerSerial {0};
     bool m_mouseFlag = false;
 
     //动画是否完成
@@ -240,12 +247,25 @@ private:
     QPropertyAnimation *paopen;
     QPropertyAnimation *paClose;
 };
+/*
+   class viewProgBarLoad
+   generates the film strip of the current file. slices are spread over a
+   thread pool where every worker owns its decoder, and each slice is
+   handed out through sliceReady as soon as it is decoded. cancel() stops
+   all workers at the next packet. completed strips are saved to the
+   PersistentManager.
+*/
 class viewProgBarLoad: public QThread
 {
     Q_OBJECT
 public:
     explicit viewProgBarLoad(PlayerEngine *engine = nullptr, DMRSlider *progBar = nullptr, ToolboxProxy *parent = 0);
 
+    void cancel();
+
+    // number of 8px slices on a bar this wide
+    static int sliceCount(int width);
+
 public slots:
     void loadViewProgBar(QSize size);
 signals:
@@ -253,6 +273,7 @@ signals:
     void hoverChanged(int);
     void sliderMoved(int);
     void indicatorMoved(int);
+    void sliceReady(int index, const QImage &img, const QImage &img_black);
     void sigFinishiLoad(QSize size);
     void finished();
 
@@ -280,6 +301,16 @@ private:
     QSize _size;
     bool isLoad = false;
 
+    QUrl _url;
+    QString _file;
+    qint64 _duration {0}; // msecs
+    int _width {0};       // of the progress bar, read in the gui thread
+    int _sliceCount {0};
+    QThreadPool _pool;
+    QAtomicInt _cancel {0};
+    QMutex _slicesLock;
+    QVector<QImage> _slices;
+
 
 };
 }